@@ -11,6 +11,9 @@ def sort():
     with open('sort_performance.csv', 'r') as csvfile:
         plots = csv.DictReader(csvfile, delimiter=',')
         for row in plots:
+            # Sorting by one thread: rows with more threads are compared by the sort_threads plot.
+            if row.get('thread_count', '1') != '1':
+                continue
             x.append(float(row['set_size']))
             worst.append(float(row['worst_case_single']))
             random.append(float(row['random_single']))
@@ -31,6 +34,34 @@ def sort():
     plt.savefig("sort.svg", format="svg")
 
 
+def sort_threads():
+    rows = []
+    with open('sort_performance.csv', 'r') as csvfile:
+        rows = [row for row in csv.DictReader(csvfile, delimiter=',') if 'thread_count' in row]
+    if not rows:
+        return
+    # The largest set sorted by the linear algorithm.
+    size = max(float(row['set_size']) for row in rows)
+    rows = [row for row in rows if float(row['set_size']) == size]
+    x = [float(row['thread_count']) for row in rows]
+
+    fig, ax = plt.subplots(1, 1)
+
+    ax.set_title('Linear sort performance vs thread count, set size ' + str(int(size)))
+    ax.set_xlabel('Thread count')
+    ax.set_ylabel('Time, sec')
+    ax.plot(x, [float(row['worst_case_single_linear']) for row in rows], label='Worst single', marker='o', markersize=3, linewidth=1.2)
+    ax.plot(x, [float(row['no_parents_linear']) for row in rows], label='No parents', marker='o', markersize=3, linewidth=1.2)
+    ax.plot(x, [float(row['random_single_linear']) for row in rows], label='Random single', marker='o', markersize=3, linewidth=1.2)
+    if 'single_root_linear' in rows[0]:
+        ax.plot(x, [float(row['single_root_linear']) for row in rows], label='Single root', marker='o', markersize=3, linewidth=1.2)
+
+    ax.legend()
+    plt.figure(7)
+    fig.set_size_inches(11, 8)
+    plt.savefig("sort_threads.svg", format="svg")
+
+
 def perf_thread(count, fign, total):
     x = []
     ws, wm, rs, rm, np = [], [], [], [], []
@@ -141,6 +172,7 @@ def perf_task_dur():
 
 
 sort()
+sort_threads()
 perf_thread(count='10', fign=2, total='5.005')
 perf_thread(count='100', fign=3, total='5.050')
 perf_set_fixed_runtime()
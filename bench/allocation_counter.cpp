@@ -0,0 +1,60 @@
+#include "allocation_counter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+// Replaced global allocation functions: array and aligned forms fall back to these ones or aren't counted.
+// The size of an allocation is kept in a header in front of it to be subtracted on delete.
+static std::atomic<size_t> _allocation_count(0);
+static std::atomic<size_t> _allocated_bytes(0);
+static std::atomic<size_t> _peak_bytes(0);
+static const size_t _header_size = alignof(std::max_align_t);
+
+void * operator new(size_t size) {
+    ++_allocation_count;
+    auto ptr = static_cast<char *>(std::malloc(_header_size + size));
+    if (ptr == nullptr) throw std::bad_alloc();
+    *reinterpret_cast<size_t *>(ptr) = size;
+    auto bytes = _allocated_bytes += size;
+    auto peak = _peak_bytes.load();
+    while (bytes > peak && !_peak_bytes.compare_exchange_weak(peak, bytes)) {}
+    return ptr + _header_size;
+}
+
+void operator delete(void * ptr) noexcept {
+    if (ptr == nullptr) return;
+    auto header = static_cast<char *>(ptr) - _header_size;
+    _allocated_bytes -= *reinterpret_cast<size_t *>(header);
+    std::free(header);
+}
+
+void operator delete(void * ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+namespace qp {
+
+size_t allocation_count() {
+    return _allocation_count;
+}
+
+
+
+size_t allocated_bytes() {
+    return _allocated_bytes;
+}
+
+
+
+size_t peak_bytes() {
+    return _peak_bytes;
+}
+
+
+
+void reset_peak_bytes() {
+    _peak_bytes = _allocated_bytes.load();
+}
+
+}
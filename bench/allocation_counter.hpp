@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+
+namespace qp {
+
+// Number of heap allocations (operator new calls) made by the benchmark executable so far.
+size_t allocation_count();
+
+// Bytes allocated on the heap (operator new) and not freed yet.
+size_t allocated_bytes();
+
+// The largest value of allocated_bytes() since the last reset_peak_bytes().
+size_t peak_bytes();
+void reset_peak_bytes();
+
+}
@@ -0,0 +1,512 @@
+#include "bench.hpp"
+#include "../test/task_generator.hpp"
+#include "allocation_counter.hpp"
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+
+namespace qp {
+
+int bench::_warmup = 1;
+int bench::_repetitions = 10;
+
+
+
+void bench::set_repetitions(int warmup, int repetitions) {
+    _warmup = std::max(warmup, 0);
+    _repetitions = std::max(repetitions, 1);
+}
+
+
+
+// Times generation, sort, dispatch (pop_next and set_done without executing tasks) and execution
+// (task_manager's run and wait on a sorted set) separately for every test set and thread count.
+void bench::phase_performance(int max_count, int set_size, long total_millisec, std::string && outputfile) {
+    _printline("Bench1: phases - generation, sort, dispatch, execution (" + std::to_string(set_size) + " tasks)");
+    std::ofstream fout;
+    fout.open(outputfile);
+    fout << "set,thread_count,generation,generation_p99,sort,sort_p99,"
+         << "dispatch,dispatch_p99,execution,execution_p99" << std::endl;
+
+    std::stringstream ss;
+    auto times = std::vector<std::vector<double>>(4);
+    for (auto & set : _test_sets()) {
+        for (auto i = 1; i < max_count; ++i) {
+            for (auto & phase : times) phase.clear();
+            for (auto r = 0; r < _warmup; ++r) {
+                _measure_phases(set.func, i, set_size, total_millisec, times);
+            }
+            for (auto & phase : times) phase.clear();
+            for (auto r = 0; r < _repetitions; ++r) {
+                _measure_phases(set.func, i, set_size, total_millisec, times);
+            }
+
+            ss.str("");
+            ss << set.name << "," << i;
+            for (auto & phase : times) {
+                auto phase_stats = _stats(phase);
+                ss << "," << phase_stats.median << "," << phase_stats.p99;
+            }
+            _printline("   > phases " + ss.str());
+            fout << ss.str() << std::endl;
+        }
+    }
+    fout.close();
+}
+
+
+
+// Same columns as test::sort_performance (medians), followed by the 99th percentiles.
+void bench::sort_performance(std::string && outputfile, int max_thread_count) {
+    _printline("Bench2: task_sort - performance");
+    std::ofstream fout;
+    fout.open(outputfile);
+    fout << "set_size,thread_count,worst_case_single,random_single,no_parents,"
+         << "worst_case_single_linear,random_single_linear,no_parents_linear,single_root_linear,"
+         << "worst_case_single_p99,random_single_p99,no_parents_p99,"
+         << "worst_case_single_linear_p99,random_single_linear_p99,no_parents_linear_p99,single_root_linear_p99"
+         << std::endl;
+
+    std::vector<generator_func> sets = {
+        &task_generator::test_set_worst_singleparent,
+        &task_generator::test_set_random_singleparent,
+        &task_generator::test_set_no_parent
+    };
+    std::stringstream ss;
+    std::vector<stats> results;
+    std::vector<int> mult = {1, 2, 3, 4, 6, 8, 10, 14, 16, 20, 40, 60, 80, 100};
+    for (auto i : mult) {
+        auto set_size = i*10000;
+        for (auto t = 1; t <= max_thread_count; t *= 2) {
+            results.clear();
+            for (auto algorithm : { sort_algorithm::chained, sort_algorithm::linear }) {
+                for (auto & set : sets) {
+                    results.push_back( _repeat([&]() { return _measure_sort(set, set_size, algorithm, t); }) );
+                }
+            }
+            // A wide graph of one component.
+            results.push_back( _repeat([&]() {
+                return _measure_sort(&task_generator::test_set_single_root, set_size, sort_algorithm::linear, t);
+            }) );
+
+            ss.str("");
+            ss << set_size << "," << t;
+            for (auto & result : results) ss << "," << result.median;
+            for (auto & result : results) ss << "," << result.p99;
+            _printline("   > sorting " + ss.str());
+            fout << ss.str() << std::endl;
+        }
+    }
+    fout.close();
+}
+
+
+
+// Same columns as test::performance_vs_thread (medians), followed by the 99th percentiles.
+void bench::performance_vs_thread(int max_count, std::string && outputfile, schedule_mode mode) {
+    _printline("Bench3: task_manager - performance vs thread count");
+    std::ofstream fout;
+    fout.open(outputfile);
+    std::string columns[] = { "worst_single", "worst_multi", "random_single", "random_multi", "no_parents" };
+    fout << "thread_count";
+    for (auto & column : columns) fout << "," << column << "_10," << column << "_100";
+    for (auto & column : columns) fout << "," << column << "_10_p99," << column << "_100_p99";
+    fout << std::endl;
+
+    std::vector<generator_func> sets = {
+        &task_generator::test_set_worst_singleparent,
+        &task_generator::test_set_worst_multiparent,
+        &task_generator::test_set_random_singleparent,
+        &task_generator::test_set_random_multiparent,
+        &task_generator::test_set_no_parent
+    };
+    std::stringstream ss;
+    std::vector<stats> results;
+    for (auto i = 1; i < max_count; ++i) {
+        results.clear();
+        for (auto & set : sets) {
+            results.push_back( _repeat([&]() { return _measure_execution(set, i, 10, 5005, mode); }) );
+            results.push_back( _repeat([&]() { return _measure_execution(set, i, 100, 5050, mode); }) );
+        }
+
+        ss.str("");
+        ss << i;
+        for (auto & result : results) ss << "," << result.median;
+        for (auto & result : results) ss << "," << result.p99;
+        _printline("   > task_manager " + ss.str());
+        fout << ss.str() << std::endl;
+    }
+    fout.close();
+}
+
+
+
+// Empty (0 ns) and tiny tasks instead of millisecond jobs: the cost of the scheduler itself.
+// ns_per_dispatch is thread time per task not spent in task bodies: (time * thread_count - set_size * task_ns) / set_size.
+void bench::overhead_performance(int max_count, int set_size, std::string && outputfile) {
+    _printline("Bench4: task_manager - overhead with empty and tiny tasks (" + std::to_string(set_size) + " tasks)");
+    std::ofstream fout;
+    fout.open(outputfile);
+    fout << "set,schedule_mode,task_ns,thread_count,tasks_per_sec,ns_per_dispatch,time,time_p99" << std::endl;
+
+    std::stringstream ss;
+    std::vector<long> durations = {0, 100, 1000, 10000};
+    for (auto & set : _test_sets()) {
+        for (auto mode : { schedule_mode::shared_queue, schedule_mode::work_stealing }) {
+            for (auto task_nanosec : durations) {
+                for (auto i = 1; i < max_count; ++i) {
+                    auto result = _repeat([&]() { return _measure_overhead(set.func, i, set_size, task_nanosec, mode); });
+                    auto tasks_per_sec = set_size / result.median;
+                    auto ns_per_dispatch = (result.median * 1e9 * i - (double) set_size * task_nanosec) / set_size;
+
+                    ss.str("");
+                    ss << set.name << "," << (mode == schedule_mode::shared_queue ? "shared_queue" : "work_stealing")
+                       << "," << task_nanosec << "," << i << "," << tasks_per_sec << "," << ns_per_dispatch
+                       << "," << result.median << "," << result.p99;
+                    _printline("   > overhead " + ss.str());
+                    fout << ss.str() << std::endl;
+                }
+            }
+        }
+    }
+    fout.close();
+}
+
+
+
+// Builds and clears sets of tasks created on the heap (std::make_unique) and in the task_vector's arena,
+// bound with futures or detached. Allocations are counted in one build into a cleared task vector.
+void bench::allocation_performance(std::string && outputfile) {
+    _printline("Bench5: task_vector - heap vs arena tasks");
+    std::ofstream fout;
+    fout.open(outputfile);
+    std::string columns[] = { "heap", "arena", "arena_detached" };
+    fout << "set_size";
+    for (auto & column : columns) fout << "," << column << "_build";
+    for (auto & column : columns) fout << "," << column << "_clear";
+    for (auto & column : columns) fout << "," << column << "_allocations";
+    for (auto & column : columns) fout << "," << column << "_allocations_per_task";
+    fout << std::endl;
+
+    std::stringstream ss;
+    std::vector<int> mult = {1, 2, 4, 10, 20, 40, 100};
+    for (auto i : mult) {
+        auto set_size = i*10000;
+        ss.str("");
+        ss << set_size;
+
+        std::vector<stats> build, clear;
+        std::vector<size_t> allocations;
+        for (auto variant : { 0, 1, 2 }) {
+            auto in_arena = variant > 0;
+            auto detached = variant == 2;
+            auto tasks = task_vector();
+            build.push_back( _repeat([&]() {
+                tasks.clear();
+                auto timer = std::chrono::steady_clock::now();
+                _build_set(set_size, in_arena, detached, tasks);
+                return _elapsed(timer);
+            }) );
+            clear.push_back( _repeat([&]() {
+                _build_set(set_size, in_arena, detached, tasks);
+                auto timer = std::chrono::steady_clock::now();
+                tasks.clear();
+                return _elapsed(timer);
+            }) );
+            auto count = allocation_count();
+            _build_set(set_size, in_arena, detached, tasks);
+            allocations.push_back(allocation_count() - count);
+        }
+
+        for (auto & result : build) ss << "," << result.median;
+        for (auto & result : clear) ss << "," << result.median;
+        for (auto count : allocations) ss << "," << count;
+        for (auto count : allocations) ss << "," << (double) count / set_size;
+        _printline("   > allocations " + ss.str());
+        fout << ss.str() << std::endl;
+    }
+    fout.close();
+}
+
+
+
+// Heap bytes per task of sets of tasks with captured payloads, created on the heap and in the task_vector's arena:
+// once they are sorted, at the peak of execution and when all tasks are done (the task vector is still alive).
+// Bytes are counted by the replaced operator new, so they are exact and don't include the memory of threads.
+void bench::memory_performance(int thread_count, size_t payload, std::string && outputfile) {
+    _printline("Bench6: task_manager - heap memory per task");
+    std::ofstream fout;
+    fout.open(outputfile);
+    std::string columns[] = { "heap", "arena" };
+    fout << "set_size";
+    for (auto & column : columns) fout << "," << column << "_sorted," << column << "_peak," << column << "_finished";
+    fout << std::endl;
+
+    std::stringstream ss;
+    std::vector<int> mult = {1, 2, 4, 10, 20, 40, 100};
+    for (auto i : mult) {
+        auto set_size = i*10000;
+        ss.str("");
+        ss << set_size;
+        for (auto in_arena : { false, true }) {
+            auto baseline = allocated_bytes();
+            auto tasks = task_vector();
+            _build_set(set_size, in_arena, false, tasks, payload);
+            tasks.sort();
+            auto sorted = allocated_bytes() - baseline;
+
+            auto manager = task_manager(std::move(tasks), thread_count);
+            reset_peak_bytes();
+            manager.run();
+            manager.wait();
+            auto peak = peak_bytes() - baseline;
+            auto finished = allocated_bytes() - baseline;
+            ss << "," << (double) sorted / set_size << "," << (double) peak / set_size
+               << "," << (double) finished / set_size;
+        }
+        _printline("   > memory " + ss.str());
+        fout << ss.str() << std::endl;
+    }
+    fout.close();
+}
+
+
+
+// Tasks spin task_nanosec each, so the graph alone sets the bound: the worst sets are chains (parallelism 1),
+// the sets without parents are bound by the thread count. Every column is the median of its repetitions.
+void bench::efficiency_performance(int max_count, int set_size, long task_nanosec, std::string && outputfile) {
+    _printline("Bench7: task_manager - efficiency against work / span (" + std::to_string(set_size) + " tasks)");
+    std::ofstream fout;
+    fout.open(outputfile);
+    fout << "set,schedule_mode,thread_count,time,work,span,parallelism,speedup,speedup_bound,efficiency,"
+         << "lock_wait,overhead_ns_per_task" << std::endl;
+
+    std::stringstream ss;
+    for (auto & set : _test_sets()) {
+        for (auto mode : { schedule_mode::shared_queue, schedule_mode::work_stealing }) {
+            for (auto i = 1; i < max_count; ++i) {
+                for (auto r = 0; r < _warmup; ++r) {
+                    _measure_report(set.func, i, set_size, task_nanosec, mode);
+                }
+                auto columns = std::vector<std::vector<double>>(9);
+                for (auto r = 0; r < _repetitions; ++r) {
+                    auto report = _measure_report(set.func, i, set_size, task_nanosec, mode);
+                    auto values = { report.elapsed, report.work, report.span, report.parallelism, report.speedup,
+                                    report.speedup_bound, report.efficiency, report.lock_wait,
+                                    report.overhead_per_task * 1e9 };
+                    size_t c = 0;
+                    for (auto value : values) {
+                        columns[c++].push_back(value);
+                    }
+                }
+
+                ss.str("");
+                ss << set.name << "," << (mode == schedule_mode::shared_queue ? "shared_queue" : "work_stealing")
+                   << "," << i;
+                for (auto & column : columns) {
+                    ss << "," << _stats(column).median;
+                }
+                _printline("   > efficiency " + ss.str());
+                fout << ss.str() << std::endl;
+            }
+        }
+    }
+    fout.close();
+}
+
+
+
+std::vector<bench::test_set> bench::_test_sets() {
+    return {
+        { "worst_single", &task_generator::test_set_worst_singleparent },
+        { "worst_multi", &task_generator::test_set_worst_multiparent },
+        { "random_single", &task_generator::test_set_random_singleparent },
+        { "random_multi", &task_generator::test_set_random_multiparent },
+        { "no_parents", &task_generator::test_set_no_parent },
+        { "no_parents_equal", &task_generator::test_set_no_parent_equal }
+    };
+}
+
+
+
+void bench::_printline(std::string && text) {
+    std::cout << text << std::endl;
+}
+
+
+
+double bench::_elapsed(std::chrono::steady_clock::time_point timer) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - timer).count();
+}
+
+
+
+// The 99th percentile is the nearest rank: the largest time unless there are more than 100 repetitions.
+bench::stats bench::_stats(std::vector<double> & times) {
+    std::sort(times.begin(), times.end());
+    auto n = times.size();
+    auto median = n % 2 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+    auto rank = (size_t) std::ceil(0.99 * n);
+    return { median, times[std::max(rank, (size_t) 1) - 1] };
+}
+
+
+
+bench::stats bench::_repeat(const std::function<double()> & measure) {
+    for (auto r = 0; r < _warmup; ++r) {
+        measure();
+    }
+    auto times = std::vector<double>();
+    times.reserve(_repetitions);
+    for (auto r = 0; r < _repetitions; ++r) {
+        times.push_back(measure());
+    }
+    return _stats(times);
+}
+
+
+
+// Appends generation, sort, dispatch and execution times to out[0..3].
+void bench::_measure_phases(const generator_func & func, int thread_count, int set_size, long total_millisec,
+                            std::vector<std::vector<double>> & out) {
+    auto tasks = task_vector();
+    auto timer = std::chrono::steady_clock::now();
+    func(set_size, total_millisec, false, tasks);
+    out[0].push_back(_elapsed(timer));
+
+    timer = std::chrono::steady_clock::now();
+    tasks.sort();
+    out[1].push_back(_elapsed(timer));
+
+    // Pops and marks done all tasks in one thread without executing them.
+    timer = std::chrono::steady_clock::now();
+    task_ptr tsk;
+    size_t pos = 0;
+    auto has_next = true;
+    while (has_next) {
+        tsk.reset();
+        has_next = tasks.pop_next(tsk, pos);
+        if (tsk != nullptr) {
+            tasks.set_done(pos);
+        }
+    }
+    out[2].push_back(_elapsed(timer));
+
+    // The dispatched set can't be executed, a new one is generated and sorted outside of the timer.
+    func(set_size, total_millisec, false, tasks);
+    tasks.sort();
+    auto manager = task_manager(std::move(tasks), thread_count);
+    timer = std::chrono::steady_clock::now();
+    manager.run();
+    manager.wait();
+    out[3].push_back(_elapsed(timer));
+}
+
+
+
+double bench::_measure_sort(const generator_func & func, int set_size, sort_algorithm algorithm, int thread_count) {
+    auto tasks = task_vector();
+    func(set_size, 1000, false, tasks);
+    auto timer = std::chrono::steady_clock::now();
+    tasks.sort(algorithm, thread_count);
+    return _elapsed(timer);
+}
+
+
+
+// Sorting is included as in test::performance_vs_thread.
+double bench::_measure_execution(const generator_func & func, int thread_count, int set_size, long total_millisec,
+                                 schedule_mode mode) {
+    auto tasks = task_vector();
+    func(set_size, total_millisec, false, tasks);
+    auto manager = task_manager(std::move(tasks), thread_count, mode);
+    auto timer = std::chrono::steady_clock::now();
+    manager.run();
+    manager.wait();
+    return _elapsed(timer);
+}
+
+
+
+// Generator's jobs are replaced with empty functions or spins of task_nanosec, weights keep the set's order.
+double bench::_measure_overhead(const generator_func & func, int thread_count, int set_size, long task_nanosec,
+                                schedule_mode mode) {
+    auto tasks = task_vector();
+    func(set_size, (long) set_size * (set_size + 1) / 2, false, tasks);
+    for (auto i = 0; i < set_size; ++i) {
+        if (task_nanosec == 0) {
+            tasks[i]->bind([]() {});
+        }
+        else {
+            tasks[i]->bind(&bench::_spin, task_nanosec);
+        }
+    }
+    tasks.sort();
+    auto manager = task_manager(std::move(tasks), thread_count, mode);
+    auto timer = std::chrono::steady_clock::now();
+    manager.run();
+    manager.wait();
+    return _elapsed(timer);
+}
+
+
+
+// The same set as _measure_overhead, executed with metrics enabled.
+run_report bench::_measure_report(const generator_func & func, int thread_count, int set_size, long task_nanosec,
+                                  schedule_mode mode) {
+    auto tasks = task_vector();
+    func(set_size, (long) set_size * (set_size + 1) / 2, false, tasks);
+    for (auto i = 0; i < set_size; ++i) {
+        tasks[i]->bind(&bench::_spin, task_nanosec);
+    }
+    tasks.sort();
+    auto manager = task_manager(std::move(tasks), thread_count, mode);
+    manager.metrics().enable();
+    manager.run();
+    manager.wait();
+    return manager.report();
+}
+
+
+
+// Task i has parents i/2 and i/3, tasks are bound to empty functions that capture payload bytes.
+void bench::_build_set(int set_size, bool in_arena, bool detached, task_vector & out, size_t payload) {
+    out.reserve(set_size);
+    auto ids = std::vector<task_id>(set_size);
+    auto parents = std::vector<task_id>();
+    for (auto i = 0; i < set_size; ++i) {
+        parents.clear();
+        if (i > 0) {
+            parents.push_back(ids[i / 2]);
+            if (i / 3 != i / 2) parents.push_back(ids[i / 3]);
+        }
+        if (in_arena) {
+            auto & tsk = out.emplace(i % 100, parents);
+            if (detached) {
+                tsk.bind_detached([data = std::vector<char>(payload)]() {});
+            }
+            else {
+                tsk.bind([data = std::vector<char>(payload)]() {});
+            }
+            ids[i] = tsk.id();
+        }
+        else {
+            auto tsk = std::make_unique<task>(i % 100, parents);
+            tsk->bind([data = std::vector<char>(payload)]() {});
+            ids[i] = tsk->id();
+            out.emplace(std::move(tsk));
+        }
+    }
+}
+
+
+
+void bench::_spin(long nanosec) {
+    auto start = std::chrono::steady_clock::now();
+    auto duration = std::chrono::nanoseconds(nanosec);
+    while (std::chrono::steady_clock::now() - start < duration) {}
+}
+
+}
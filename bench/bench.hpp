@@ -0,0 +1,60 @@
+#pragma once
+#include "../include/task_manager.hpp"
+#include <functional>
+#include <chrono>
+#include <vector>
+#include <string>
+
+namespace qp {
+
+// Wall-clock benchmarks. Every measurement is taken after warmup runs and repeated,
+// the median and the 99th percentile of the repetitions are written to csv files.
+class bench {
+    typedef std::function<void(int, int, bool, task_vector &)> generator_func;
+
+    struct test_set {
+        std::string name;
+        generator_func func;
+    };
+
+    // Seconds.
+    struct stats {
+        double median;
+        double p99;
+    };
+
+public:
+    bench() = delete;
+    static void set_repetitions(int warmup, int repetitions);
+    static void phase_performance(int max_count, int set_size, long total_millisec, std::string && outputfile);
+    static void sort_performance(std::string && outputfile, int max_thread_count = 1);
+    static void performance_vs_thread(int max_count, std::string && outputfile, schedule_mode mode = schedule_mode::shared_queue);
+    static void overhead_performance(int max_count, int set_size, std::string && outputfile);
+    static void allocation_performance(std::string && outputfile);
+    static void memory_performance(int thread_count, size_t payload, std::string && outputfile);
+    static void efficiency_performance(int max_count, int set_size, long task_nanosec, std::string && outputfile);
+
+private:
+    static int _warmup;
+    static int _repetitions;
+
+    static std::vector<test_set> _test_sets();
+    static void _printline(std::string && text);
+    static double _elapsed(std::chrono::steady_clock::time_point timer);
+    static stats _stats(std::vector<double> & times);
+    static stats _repeat(const std::function<double()> & measure);
+    static void _measure_phases(const generator_func & func, int thread_count, int set_size, long total_millisec,
+                                std::vector<std::vector<double>> & out);
+    static double _measure_sort(const generator_func & func, int set_size, sort_algorithm algorithm, int thread_count = 1);
+    static double _measure_execution(const generator_func & func, int thread_count, int set_size, long total_millisec,
+                                     schedule_mode mode);
+    static double _measure_overhead(const generator_func & func, int thread_count, int set_size, long task_nanosec,
+                                    schedule_mode mode);
+    static run_report _measure_report(const generator_func & func, int thread_count, int set_size, long task_nanosec,
+                                      schedule_mode mode);
+    static void _spin(long nanosec);
+    static void _build_set(int set_size, bool in_arena, bool detached, task_vector & out, size_t payload = 0);
+
+};
+
+}
@@ -0,0 +1,41 @@
+#include "bench.hpp"
+#include <iostream>
+#include <string>
+
+// Usage: bench [phases|sort|thread|thread_stealing|overhead|allocation|memory|efficiency] [repetitions] [warmup]
+int main(int argc, char * argv[]) {
+    auto name = std::string(argc > 1 ? argv[1] : "phases");
+    auto repetitions = argc > 2 ? std::stoi(argv[2]) : 10;
+    auto warmup = argc > 3 ? std::stoi(argv[3]) : 1;
+    qp::bench::set_repetitions(warmup, repetitions);
+
+    if (name == "phases") {
+        qp::bench::phase_performance(9, 1000, 0, "phase_performance.csv");
+    }
+    else if (name == "sort") {
+        qp::bench::sort_performance("sort_performance.csv", 8);
+    }
+    else if (name == "thread") {
+        qp::bench::performance_vs_thread(64, "performance_vs_thread.csv");
+    }
+    else if (name == "thread_stealing") {
+        qp::bench::performance_vs_thread(65, "performance_vs_thread_stealing.csv", qp::schedule_mode::work_stealing);
+    }
+    else if (name == "overhead") {
+        qp::bench::overhead_performance(9, 2000, "overhead_performance.csv");
+    }
+    else if (name == "allocation") {
+        qp::bench::allocation_performance("allocation_performance.csv");
+    }
+    else if (name == "memory") {
+        qp::bench::memory_performance(4, 256, "memory_performance.csv");
+    }
+    else if (name == "efficiency") {
+        qp::bench::efficiency_performance(9, 2000, 50000, "efficiency_performance.csv");
+    }
+    else {
+        std::cout << "Usage: bench [phases|sort|thread|thread_stealing|overhead|allocation|memory|efficiency] [repetitions] [warmup]" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,2 +1,4 @@
 #pragma once
-#include "../src/task_manager.hpp"
\ No newline at end of file
+#include "../src/task_manager.hpp"
+#include "../src/thread_pool.hpp"
+#include "../src/typed_graph.hpp"
\ No newline at end of file
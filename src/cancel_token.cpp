@@ -0,0 +1,24 @@
+#include "cancel_token.hpp"
+
+namespace qp {
+
+cancel_token::cancel_token():
+    _is_graph_cancelled(nullptr),
+    _tasks(nullptr),
+    _position(0) {}
+
+
+
+cancel_token::cancel_token(const std::atomic_bool & IsGraphCancelled, const task_vector & Tasks, size_t Position):
+    _is_graph_cancelled(&IsGraphCancelled),
+    _tasks(&Tasks),
+    _position(Position) {}
+
+
+
+bool cancel_token::is_cancelled() const {
+    if (_tasks == nullptr) return false;
+    return *_is_graph_cancelled || _tasks->is_cancelled(_position);
+}
+
+}
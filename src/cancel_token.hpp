@@ -0,0 +1,24 @@
+#pragma once
+#include "task_vector.hpp"
+#include <atomic>
+
+namespace qp {
+
+// Cancellation status of a running task that the task can poll to stop early: set when its graph is cancelled
+// or when the task or one of its ancestors is cancelled. A default token is never cancelled.
+class cancel_token {
+private:
+    const std::atomic_bool * _is_graph_cancelled;
+    const task_vector * _tasks;
+    size_t _position;
+
+public:
+    cancel_token();
+    cancel_token(const std::atomic_bool & IsGraphCancelled, const task_vector & Tasks, size_t Position);
+
+    // Thread-safe.
+    bool is_cancelled() const;
+
+};
+
+}
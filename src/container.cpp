@@ -2,18 +2,11 @@
 
 namespace qp {
 
-container::container(const std::vector<task_ptr> & Tasks):
+container::container(size_t Size):
     next(),
     current(),
     temp_queue(),
-    positions(),
-    visited(Tasks.size(), false)
-{
-    positions.reserve(Tasks.size());
-    for (auto it = Tasks.begin(); it < Tasks.end(); ++it) {
-        positions.emplace((*it)->id(), std::distance(Tasks.begin(), it));
-    }
-}
+    visited(Size, false) {}
 
 
 
@@ -70,8 +63,8 @@ void container::move_current_to_next(size_t Position) {
 
 
 
-void container::add_parent_to_next(task_id ParentId) {
-    auto pos = positions[ParentId];
+void container::add_parent_to_next(size_t ParentPosition) {
+    auto pos = ParentPosition;
     // If parent isn't visited yet or not in next already.
     if (!visited[pos]) {
         // Add parent to the next iteration and remove it from thecurrent iteration.
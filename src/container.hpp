@@ -3,7 +3,6 @@
 #include <set>
 #include <queue>
 #include <vector>
-#include <unordered_map>
 
 namespace qp {
 
@@ -19,9 +18,6 @@ public:
     // Temporary queue of chained tasks in right order to be placed in final sorted vector.
     std::deque<size_t> temp_queue;
     
-    // Tasks' positions by their IDs.
-    std::unordered_map<task_id, size_t> positions;
-    
     // Indicates whether a task in the temp_queue / in the final sorted vector.
     // False - not visited yet / remain in current iteration
     // True - is visited (in temp_queue or removed) / remove to next iteration.
@@ -31,8 +27,8 @@ public:
     bool next_are_parentless;
 
 public:
-    // Creates new container, fills positions and visited.
-    container(const std::vector<task_ptr> & Tasks);
+    // Creates new container for Size tasks, fills visited.
+    container(size_t Size);
 
     // Sets task that are to be used in current iteration.
     void set_current(size_t Position);
@@ -53,8 +49,8 @@ public:
     // Moves task from current to next and marks it as visited.
     void move_current_to_next(size_t Position);
 
-    // Adds task's parent to next by id if parent isn't in next or visited.
-    void add_parent_to_next(task_id ParentId);
+    // Adds task's parent to next by position if parent isn't in next or visited.
+    void add_parent_to_next(size_t ParentPosition);
 
 };
 
@@ -0,0 +1,50 @@
+#include "failure_report.hpp"
+#include <sstream>
+#include <algorithm>
+
+namespace qp {
+
+bool failure_report::empty() const {
+    return failures.empty() && skipped.empty() && !is_cancelled;
+}
+
+
+
+std::string failure_report::message() const {
+    std::ostringstream out;
+    out << failures.size() << " tasks failed, " << skipped.size() << " tasks skipped"
+        << (is_cancelled ? ", the graph was cancelled" : "") << ".";
+    auto count = std::min(failures.size(), (size_t) 16);
+    for (size_t i = 0; i < count; ++i) {
+        out << (i == 0 ? " " : "; ") << "Task " << failures[i].id << " (" << failures[i].attempts
+            << (failures[i].attempts == 1 ? " attempt): " : " attempts): ") << failures[i].what;
+    }
+    if (count < failures.size()) {
+        out << "; ...";
+    }
+    return out.str();
+}
+
+
+
+void failure_report::rethrow() const {
+    if (!failures.empty()) {
+        std::rethrow_exception(failures.front().error);
+    }
+}
+
+
+
+std::string describe_current_exception() {
+    try {
+        throw;
+    }
+    catch (const std::exception & error) {
+        return error.what();
+    }
+    catch (...) {
+        return "unknown exception";
+    }
+}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "task.hpp"
+#include <vector>
+#include <string>
+#include <exception>
+
+namespace qp {
+
+// A task that threw on its last attempt.
+struct task_failure {
+public:
+    task_id id;
+    int attempts;
+    std::exception_ptr error;
+    // what() of a std::exception, "unknown exception" otherwise.
+    std::string what;
+
+};
+
+// Failures of a run and the tasks that weren't executed because of them or because of cancellation.
+struct failure_report {
+public:
+    std::vector<task_failure> failures;
+    std::vector<task_id> skipped;
+    bool is_cancelled = false;
+
+public:
+    // True if all tasks were executed successfully.
+    bool empty() const;
+
+    // Counts of failed and skipped tasks followed by the failures, at most 16 of them.
+    std::string message() const;
+
+    // Rethrows the exception of the first failure, if any.
+    void rethrow() const;
+
+};
+
+// Explains the exception that is being handled: call it in a catch block.
+std::string describe_current_exception();
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <tuple>
+
+namespace qp {
+
+// Result and parameter types of a function pointer or a functor with a single, non-template operator().
+template<class Func>
+struct function_traits : function_traits<decltype(&Func::operator())> {};
+
+template<class Result, class ... Args>
+struct function_traits<Result (*)(Args...)> {
+    using result = Result;
+    using arguments = std::tuple<Args...>;
+};
+
+template<class Result, class ... Args>
+struct function_traits<Result (&)(Args...)> : function_traits<Result (*)(Args...)> {};
+
+template<class Result, class ... Args>
+struct function_traits<Result(Args...)> : function_traits<Result (*)(Args...)> {};
+
+template<class Class, class Result, class ... Args>
+struct function_traits<Result (Class::*)(Args...)> : function_traits<Result (*)(Args...)> {};
+
+template<class Class, class Result, class ... Args>
+struct function_traits<Result (Class::*)(Args...) const> : function_traits<Result (*)(Args...)> {};
+
+}
@@ -0,0 +1,434 @@
+#include "graph_file.hpp"
+#include "radix_sort.hpp"
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace qp {
+
+static_assert(sizeof(size_t) == sizeof(std::uint64_t), "Mapped graphs' rows are read as size_t.");
+static_assert(sizeof(task_id) == sizeof(std::uint64_t), "Mapped graphs' IDs are 8 bytes.");
+
+struct graph_header {
+    char magic[8];
+    std::uint64_t version;
+    std::uint64_t node_count;
+    std::uint64_t edge_count;
+    std::uint64_t kind_count;
+    std::uint64_t max_id;
+    std::uint64_t reserved[2];
+};
+
+static const char _graph_magic[8] = { 'q', 'p', 'g', 'r', 'a', 'p', 'h', '\0' };
+static const std::uint64_t _graph_version = 1;
+
+// Arrays' sizes are padded to 8 bytes.
+static size_t _padded(size_t Size) {
+    return (Size + 7) / 8 * 8;
+}
+
+
+
+// CSR rows of Count nodes: offsets are monotonic from 0 to EdgeCount, indices are nodes.
+static bool _valid_rows(const size_t * Offset, const size_t * Index, size_t Count, size_t EdgeCount) {
+    if (Offset[0] != 0 || Offset[Count] != EdgeCount) return false;
+    for (size_t i = 0; i < Count; ++i) {
+        if (Offset[i] > Offset[i + 1]) return false;
+    }
+    return std::all_of(Index, Index + EdgeCount, [Count](size_t Node) { return Node < Count; });
+}
+
+
+
+graph_file::graph_file() {
+    _reset();
+}
+
+
+
+graph_file::graph_file(graph_file && GraphFile) {
+    _reset();
+    *this = std::move(GraphFile);
+}
+
+
+
+graph_file & graph_file::operator=(graph_file && GraphFile) {
+    if (this != &GraphFile) {
+        close();
+        _data = GraphFile._data;
+        _size = GraphFile._size;
+        _header = GraphFile._header;
+        _id = GraphFile._id;
+        _weight = GraphFile._weight;
+        _kind = GraphFile._kind;
+        _by_weight = GraphFile._by_weight;
+        _by_id = GraphFile._by_id;
+        _parent_offset = GraphFile._parent_offset;
+        _parent_index = GraphFile._parent_index;
+        _child_offset = GraphFile._child_offset;
+        _child_index = GraphFile._child_index;
+        GraphFile._reset();
+    }
+    return *this;
+}
+
+
+
+graph_file::~graph_file() {
+    close();
+}
+
+
+
+bool graph_file::open(const std::string & Path) {
+    close();
+#ifdef _WIN32
+    auto file = CreateFileA(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG) sizeof(graph_header)) {
+        CloseHandle(file);
+        return false;
+    }
+    auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) return false;
+    auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == nullptr) return false;
+    _data = (const char *) data;
+    _size = (size_t) size.QuadPart;
+#else
+    auto file = ::open(Path.c_str(), O_RDONLY);
+    if (file < 0) return false;
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size < (off_t) sizeof(graph_header)) {
+        ::close(file);
+        return false;
+    }
+    auto data = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_SHARED, file, 0);
+    ::close(file);
+    if (data == MAP_FAILED) return false;
+    _data = (const char *) data;
+    _size = (size_t) info.st_size;
+#endif
+
+    // The header is checked against the file size, then the arrays are checked once: indices read by sorting
+    // and dispatching must stay inside the mapping. Counts are bounded first, so the size can't overflow.
+    _header = (const graph_header *) _data;
+    auto n = _header->node_count;
+    auto e = _header->edge_count;
+    if (std::memcmp(_header->magic, _graph_magic, sizeof(_graph_magic)) != 0 || _header->version != _graph_version ||
+        n > _size / 8 || e > _size / 8 ||
+        _size != sizeof(graph_header) + 8 * (n + _padded(4 * n) / 8 * 2 + n * 2 + (n + 1) * 2 + e * 2)) {
+        close();
+        return false;
+    }
+    auto next = _data + sizeof(graph_header);
+    _id = (const task_id *) next;
+    next += 8 * n;
+    _weight = (const std::int32_t *) next;
+    next += _padded(4 * n);
+    _kind = (const std::uint32_t *) next;
+    next += _padded(4 * n);
+    _by_weight = (const size_t *) next;
+    next += 8 * n;
+    _by_id = (const size_t *) next;
+    next += 8 * n;
+    _parent_offset = (const size_t *) next;
+    next += 8 * (n + 1);
+    _parent_index = (const size_t *) next;
+    next += 8 * e;
+    _child_offset = (const size_t *) next;
+    next += 8 * (n + 1);
+    _child_index = (const size_t *) next;
+    if (!_is_valid()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+
+void graph_file::close() {
+    if (_data != nullptr) {
+#ifdef _WIN32
+        UnmapViewOfFile(_data);
+#else
+        munmap((void *) _data, _size);
+#endif
+    }
+    _reset();
+}
+
+
+
+bool graph_file::is_open() const {
+    return _data != nullptr;
+}
+
+
+
+size_t graph_file::size() const {
+    return _header ? _header->node_count : 0;
+}
+
+
+
+size_t graph_file::edge_count() const {
+    return _header ? _header->edge_count : 0;
+}
+
+
+
+size_t graph_file::kind_count() const {
+    return _header ? _header->kind_count : 0;
+}
+
+
+
+task_id graph_file::max_id() const {
+    return _header ? _header->max_id : 0;
+}
+
+
+
+task_id graph_file::id(size_t Node) const {
+    return _id[Node];
+}
+
+
+
+int graph_file::weight(size_t Node) const {
+    return _weight[Node];
+}
+
+
+
+std::uint32_t graph_file::kind(size_t Node) const {
+    return _kind[Node];
+}
+
+
+
+const size_t * graph_file::by_weight() const {
+    return _by_weight;
+}
+
+
+
+position_range graph_file::parents(size_t Node) const {
+    return { _parent_index + _parent_offset[Node], _parent_index + _parent_offset[Node + 1] };
+}
+
+
+
+position_range graph_file::children(size_t Node) const {
+    return { _child_index + _child_offset[Node], _child_index + _child_offset[Node + 1] };
+}
+
+
+
+size_t graph_file::find(task_id Id) const {
+    auto last = _by_id + size();
+    auto it = std::lower_bound(_by_id, last, Id, [this](size_t Node, task_id Value) {
+        return _id[Node] < Value;
+    });
+    return it != last && _id[*it] == Id ? *it : npos;
+}
+
+
+
+// Children's rows must be the transpose of parents' rows, as written by graph_builder: dispatching counts parents
+// by the former and releases children by the latter. by_id must be ascending by IDs up to max_id, so it holds
+// distinct nodes; by_weight must hold every node once.
+bool graph_file::_is_valid() const {
+    auto n = size();
+    auto e = edge_count();
+    if (!_valid_rows(_parent_offset, _parent_index, n, e) || !_valid_rows(_child_offset, _child_index, n, e)) {
+        return false;
+    }
+    auto next = std::vector<size_t>(_child_offset, _child_offset + n);
+    for (size_t i = 0; i < n; ++i) {
+        for (auto par : parents(i)) {
+            if (next[par] == _child_offset[par + 1] || _child_index[next[par]++] != i) return false;
+        }
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (_by_id[i] >= n || (i > 0 && _id[_by_id[i - 1]] >= _id[_by_id[i]])) return false;
+    }
+    if (n > 0 && _id[_by_id[n - 1]] > max_id()) return false;
+    auto is_listed = std::vector<bool>(n, false);
+    for (size_t i = 0; i < n; ++i) {
+        if (_by_weight[i] >= n || is_listed[_by_weight[i]]) return false;
+        is_listed[_by_weight[i]] = true;
+    }
+    return std::all_of(_kind, _kind + n, [this](std::uint32_t Kind) { return Kind < kind_count(); });
+}
+
+
+
+void graph_file::_reset() {
+    _data = nullptr;
+    _size = 0;
+    _header = nullptr;
+    _id = nullptr;
+    _weight = nullptr;
+    _kind = nullptr;
+    _by_weight = nullptr;
+    _by_id = nullptr;
+    _parent_offset = nullptr;
+    _parent_index = nullptr;
+    _child_offset = nullptr;
+    _child_index = nullptr;
+}
+
+
+
+graph_builder::graph_builder():
+    _id(),
+    _weight(),
+    _kind(),
+    _parent_offset(1, 0),
+    _parent_id() {}
+
+
+
+void graph_builder::add(task_id Id, int Weight, std::uint32_t Kind, id_range ParentId) {
+    _id.push_back(Id);
+    _weight.push_back(Weight);
+    _kind.push_back(Kind);
+    _parent_id.insert(_parent_id.end(), ParentId.begin(), ParentId.end());
+    _parent_offset.push_back(_parent_id.size());
+}
+
+
+
+void graph_builder::add(task_id Id, int Weight, std::uint32_t Kind, const std::vector<task_id> & ParentId) {
+    add(Id, Weight, Kind, id_range{ ParentId.data(), ParentId.data() + ParentId.size() });
+}
+
+
+
+void graph_builder::reserve(size_t Size, size_t EdgeCount) {
+    _id.reserve(Size);
+    _weight.reserve(Size);
+    _kind.reserve(Size);
+    _parent_offset.reserve(Size + 1);
+    _parent_id.reserve(EdgeCount);
+}
+
+
+
+size_t graph_builder::size() const {
+    return _id.size();
+}
+
+
+
+void graph_builder::clear() {
+    _id.clear();
+    _weight.clear();
+    _kind.clear();
+    _parent_offset.assign(1, 0);
+    _parent_id.clear();
+}
+
+
+
+// Sorting by IDs and by weights is done by radix sort, parents are resolved by binary search: O(n + v*log(n)).
+bool graph_builder::write(const std::string & Path) const {
+    auto n = _id.size();
+    auto e = _parent_id.size();
+
+    auto by_id = std::vector<size_t>(n);
+    for (size_t i = 0; i < n; ++i) {
+        by_id[i] = i;
+    }
+    radix_sort(by_id, _id);
+    for (size_t i = 1; i < n; ++i) {
+        if (_id[by_id[i]] == _id[by_id[i - 1]]) return false;
+    }
+
+    // The same keys as task_vector's radix sort by weights.
+    auto keys = std::vector<std::uint32_t>(n);
+    auto by_weight = std::vector<size_t>(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = ~((std::uint32_t) _weight[i] ^ 0x80000000u);
+        by_weight[i] = i;
+    }
+    radix_sort(by_weight, keys);
+    auto weight_rank = std::vector<size_t>(n);
+    for (size_t i = 0; i < n; ++i) {
+        weight_rank[by_weight[i]] = i;
+    }
+
+    auto parent_index = std::vector<size_t>(e);
+    for (size_t i = 0; i < e; ++i) {
+        auto it = std::lower_bound(by_id.begin(), by_id.end(), _parent_id[i], [this](size_t Node, task_id Value) {
+            return _id[Node] < Value;
+        });
+        if (it == by_id.end() || _id[*it] != _parent_id[i]) return false;
+        parent_index[i] = *it;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        std::sort(parent_index.begin() + _parent_offset[i], parent_index.begin() + _parent_offset[i + 1],
+            [&weight_rank](size_t Left, size_t Right) { return weight_rank[Left] < weight_rank[Right]; });
+    }
+
+    auto child_offset = std::vector<size_t>(n + 1, 0);
+    for (auto par : parent_index) {
+        ++child_offset[par + 1];
+    }
+    for (size_t i = 0; i < n; ++i) {
+        child_offset[i + 1] += child_offset[i];
+    }
+    auto child_index = std::vector<size_t>(e);
+    auto next = std::vector<size_t>(child_offset.begin(), child_offset.end() - 1);
+    for (size_t i = 0; i < n; ++i) {
+        for (auto j = _parent_offset[i]; j < _parent_offset[i + 1]; ++j) {
+            child_index[next[parent_index[j]]++] = i;
+        }
+    }
+
+    graph_header head = {};
+    std::memcpy(head.magic, _graph_magic, sizeof(_graph_magic));
+    head.version = _graph_version;
+    head.node_count = n;
+    head.edge_count = e;
+    head.kind_count = n == 0 ? 0 : (std::uint64_t) *std::max_element(_kind.begin(), _kind.end()) + 1;
+    head.max_id = n == 0 ? 0 : _id[by_id.back()];
+
+    std::ofstream fout(Path, std::ios::binary | std::ios::trunc);
+    if (!fout) return false;
+    auto write = [&fout](const void * Data, size_t Size) {
+        fout.write((const char *) Data, Size);
+        static const char padding[8] = {};
+        fout.write(padding, _padded(Size) - Size);
+    };
+    write(&head, sizeof(head));
+    write(_id.data(), 8 * n);
+    write(_weight.data(), 4 * n);
+    write(_kind.data(), 4 * n);
+    write(by_weight.data(), 8 * n);
+    write(by_id.data(), 8 * n);
+    write(_parent_offset.data(), 8 * (n + 1));
+    write(parent_index.data(), 8 * e);
+    write(child_offset.data(), 8 * (n + 1));
+    write(child_index.data(), 8 * e);
+    return (bool) fout.flush();
+}
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "task.hpp"
+#include "task_graph.hpp"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace qp {
+
+struct graph_header;
+
+// A task graph stored in a file that is memory-mapped read-only: it isn't loaded, its rows and indices are checked
+// once when it is opened.
+// All arrays are in native byte order and 8-byte aligned after a header:
+//   task_id        id[n]               tasks' IDs
+//   std::int32_t   weight[n]           tasks' weights
+//   std::uint32_t  kind[n]             indices of tasks' functions
+//   std::uint64_t  by_weight[n]        nodes (indices in the file) descending by weights, stable
+//   std::uint64_t  by_id[n]            nodes ascending by IDs
+//   std::uint64_t  parent_offset[n+1]  parents' rows (CSR) of nodes, parents are ordered as in by_weight
+//   std::uint64_t  parent_index[e]
+//   std::uint64_t  child_offset[n+1]   children's rows (CSR) of nodes, children are in ascending order
+//   std::uint64_t  child_index[e]
+// Parents are stored ordered as the linear sort visits them, so sorting a mapped graph builds nothing.
+class graph_file {
+private:
+    const char * _data;
+    size_t _size;
+    const graph_header * _header;
+    const task_id * _id;
+    const std::int32_t * _weight;
+    const std::uint32_t * _kind;
+    const size_t * _by_weight;
+    const size_t * _by_id;
+    const size_t * _parent_offset;
+    const size_t * _parent_index;
+    const size_t * _child_offset;
+    const size_t * _child_index;
+
+public:
+    static const size_t npos = ~(size_t) 0;
+
+    graph_file();
+    graph_file(graph_file && GraphFile);
+    graph_file & operator=(graph_file && GraphFile);
+    graph_file(const graph_file & GraphFile) = delete;
+    graph_file & operator=(const graph_file & GraphFile) = delete;
+    ~graph_file();
+
+    // Maps the file. Returns false if it can't be mapped or isn't a valid graph file: O(n + e).
+    bool open(const std::string & Path);
+    void close();
+    bool is_open() const;
+
+    // Number of nodes.
+    size_t size() const;
+    size_t edge_count() const;
+
+    // Largest kind plus one.
+    size_t kind_count() const;
+    task_id max_id() const;
+
+    task_id id(size_t Node) const;
+    int weight(size_t Node) const;
+    std::uint32_t kind(size_t Node) const;
+    const size_t * by_weight() const;
+    position_range parents(size_t Node) const;
+    position_range children(size_t Node) const;
+
+    // Node with the given ID: O(log n). Returns npos if there is no such node.
+    size_t find(task_id Id) const;
+
+private:
+    bool _is_valid() const;
+    void _reset();
+
+};
+
+// Collects a graph in memory and writes it as a graph_file.
+// Tasks may be added in any order: parents are resolved by their IDs when the file is written.
+class graph_builder {
+private:
+    std::vector<task_id> _id;
+    std::vector<std::int32_t> _weight;
+    std::vector<std::uint32_t> _kind;
+    std::vector<size_t> _parent_offset;
+    std::vector<task_id> _parent_id;
+
+public:
+    graph_builder();
+
+    void add(task_id Id, int Weight, std::uint32_t Kind, id_range ParentId);
+    void add(task_id Id, int Weight, std::uint32_t Kind, const std::vector<task_id> & ParentId);
+    void reserve(size_t Size, size_t EdgeCount);
+    size_t size() const;
+    void clear();
+
+    // Returns false if IDs repeat, not all parents are present or the file can't be written.
+    bool write(const std::string & Path) const;
+
+};
+
+}
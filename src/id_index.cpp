@@ -0,0 +1,187 @@
+#include "id_index.hpp"
+#include "parallel_for.hpp"
+#include <algorithm>
+#include <mutex>
+
+namespace qp {
+
+// IDs are mixed first: IDs with a common stride would fall into a few shards otherwise.
+static size_t _shard_of(task_id Id, size_t ShardCount) {
+    return (size_t) ((Id * 0x9e3779b97f4a7c15ull) >> 32) % ShardCount;
+}
+
+
+
+id_index::id_index():
+    _first(0),
+    _table(),
+    _shards(),
+    _size(0) {}
+
+
+
+id_index::id_index(id_index && IdIndex):
+    _first(IdIndex._first),
+    _table(std::move(IdIndex._table)),
+    _shards(std::move(IdIndex._shards)),
+    _size(IdIndex._size) {
+    IdIndex.clear();
+}
+
+
+
+id_index & id_index::operator=(id_index && IdIndex) {
+    if (this != &IdIndex) {
+        _first = IdIndex._first;
+        _table = std::move(IdIndex._table);
+        _shards = std::move(IdIndex._shards);
+        _size = IdIndex._size;
+        IdIndex.clear();
+    }
+    return *this;
+}
+
+
+
+// The table is used if it's at most about twice as large as the number of IDs. Each thread fills its own block
+// of the table by CAS (a repeated ID finds its slot taken). Otherwise each thread buckets the positions of its own
+// block of IDs by shards, then inserts the buckets of its own shard from all blocks: O(n) in total.
+bool id_index::build(const std::vector<task_id> & Ids, int ThreadCount) {
+    clear();
+    auto count = Ids.size();
+    if (count == 0) return true;
+
+    auto min_id = Ids.front();
+    auto max_id = Ids.front();
+    std::mutex mutex;
+    parallel_for(count, ThreadCount, [&](size_t First, size_t Last) {
+        auto block = std::minmax_element(Ids.begin() + First, Ids.begin() + Last);
+        std::lock_guard<std::mutex> lock(mutex);
+        min_id = std::min(min_id, *block.first);
+        max_id = std::max(max_id, *block.second);
+    });
+
+    std::atomic_bool has_duplicates(false);
+    if (max_id - min_id < 2 * count + 64) {
+        _first = min_id;
+        _table = std::vector<std::atomic_size_t>(max_id - min_id + 1);
+        parallel_for(count, ThreadCount, [&](size_t First, size_t Last) {
+            for (auto i = First; i < Last; ++i) {
+                size_t empty = 0;
+                if (!_table[Ids[i] - _first].compare_exchange_strong(empty, i + 1, std::memory_order_relaxed)) {
+                    has_duplicates = true;
+                }
+            }
+        });
+    }
+    else {
+        auto shard_count = (size_t) std::max(ThreadCount, 1);
+        _shards.resize(shard_count);
+        // Positions by blocks and shards: buckets[b * shard_count + s].
+        auto buckets = std::vector<std::vector<size_t>>(shard_count * shard_count);
+        parallel_for(shard_count, ThreadCount, [&](size_t First, size_t Last) {
+            for (auto b = First; b < Last; ++b) {
+                for (auto i = b * count / shard_count; i < (b + 1) * count / shard_count; ++i) {
+                    buckets[b * shard_count + _shard_of(Ids[i], shard_count)].push_back(i);
+                }
+            }
+        }, 1);
+        parallel_for(shard_count, ThreadCount, [&](size_t First, size_t Last) {
+            for (auto s = First; s < Last; ++s) {
+                auto & shard = _shards[s];
+                size_t size = 0;
+                for (size_t b = 0; b < shard_count; ++b) {
+                    size += buckets[b * shard_count + s].size();
+                }
+                shard.reserve(size);
+                for (size_t b = 0; b < shard_count; ++b) {
+                    for (auto i : buckets[b * shard_count + s]) {
+                        if (!shard.emplace(Ids[i], i).second) {
+                            has_duplicates = true;
+                        }
+                    }
+                }
+            }
+        }, 1);
+    }
+    _size = count;
+    if (has_duplicates) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+
+
+size_t id_index::find(task_id Id) const {
+    if (Id >= _first && Id - _first < _table.size()) {
+        auto pos = _table[Id - _first].load(std::memory_order_relaxed);
+        if (pos != 0) return pos - 1;
+    }
+    if (_shards.empty()) return npos;
+    auto & shard = _shards[_shard_of(Id, _shards.size())];
+    auto it = shard.find(Id);
+    return it == shard.end() ? npos : it->second;
+}
+
+
+
+// IDs beyond the table go to the shards.
+bool id_index::emplace(task_id Id, size_t Position) {
+    if (find(Id) != npos) return false;
+    if (Id >= _first && Id - _first < _table.size()) {
+        _table[Id - _first] = Position + 1;
+    }
+    else {
+        _shard(Id).emplace(Id, Position);
+    }
+    ++_size;
+    return true;
+}
+
+
+
+void id_index::permute(const std::vector<size_t> & NewPosition, int ThreadCount) {
+    parallel_for(_table.size(), ThreadCount, [&](size_t First, size_t Last) {
+        for (auto i = First; i < Last; ++i) {
+            auto pos = _table[i].load(std::memory_order_relaxed);
+            if (pos != 0) {
+                _table[i].store(NewPosition[pos - 1] + 1, std::memory_order_relaxed);
+            }
+        }
+    });
+    parallel_for(_shards.size(), ThreadCount, [&](size_t First, size_t Last) {
+        for (auto s = First; s < Last; ++s) {
+            for (auto & item : _shards[s]) {
+                item.second = NewPosition[item.second];
+            }
+        }
+    }, 1);
+}
+
+
+
+size_t id_index::size() const {
+    return _size;
+}
+
+
+
+void id_index::clear() {
+    _first = 0;
+    std::vector<std::atomic_size_t>().swap(_table);
+    _shards.clear();
+    _size = 0;
+}
+
+
+
+std::unordered_map<task_id, size_t> & id_index::_shard(task_id Id) {
+    if (_shards.empty()) {
+        _shards.resize(1);
+    }
+    return _shards[_shard_of(Id, _shards.size())];
+}
+
+}
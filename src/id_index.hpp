@@ -0,0 +1,49 @@
+#pragma once
+#include "task.hpp"
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+
+namespace qp {
+
+// Tasks' positions by their IDs. IDs that are close to each other (e.g. given by task's counter) are indexed
+// by a table of positions by ID minus the smallest ID, other IDs - by hash maps split into shards by ID.
+// Both are built in parallel. Not thread-safe, except find().
+class id_index {
+private:
+    // Positions plus one by ID - _first, zero if there is no such ID.
+    task_id _first;
+    std::vector<std::atomic_size_t> _table;
+    std::vector<std::unordered_map<task_id, size_t>> _shards;
+    size_t _size;
+
+public:
+    static const size_t npos = ~(size_t) 0;
+
+    id_index();
+    id_index(id_index && IdIndex);
+    id_index & operator=(id_index && IdIndex);
+    id_index(const id_index & IdIndex) = delete;
+    id_index & operator=(const id_index & IdIndex) = delete;
+
+    // Indexes Ids[i] at position i by ThreadCount threads. Returns false if IDs repeat.
+    bool build(const std::vector<task_id> & Ids, int ThreadCount = 1);
+
+    // Returns npos if there is no such ID.
+    size_t find(task_id Id) const;
+
+    // Adds an ID after build(). Returns false if it is indexed already.
+    bool emplace(task_id Id, size_t Position);
+
+    // Replaces every position p with NewPosition[p].
+    void permute(const std::vector<size_t> & NewPosition, int ThreadCount = 1);
+
+    size_t size() const;
+    void clear();
+
+private:
+    std::unordered_map<task_id, size_t> & _shard(task_id Id);
+
+};
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <exception>
+#include <algorithm>
+
+namespace qp {
+
+// Calls Func(First, Last) for up to ThreadCount contiguous blocks of [0, Count) in parallel, the calling thread
+// takes the first block. Blocks are not smaller than MinBlock, so small ranges are processed by the calling thread.
+// The first exception thrown by a block is rethrown after all blocks are finished.
+template<class Func>
+void parallel_for(size_t Count, int ThreadCount, Func && func, size_t MinBlock = 4096) {
+    auto blocks = std::min((size_t) std::max(ThreadCount, 1), std::max(Count / std::max(MinBlock, (size_t) 1), (size_t) 1));
+    if (blocks == 1) {
+        func((size_t) 0, Count);
+        return;
+    }
+
+    auto errors = std::vector<std::exception_ptr>(blocks);
+    auto call = [&](size_t Block) {
+        try {
+            func(Block * Count / blocks, (Block + 1) * Count / blocks);
+        }
+        catch (...) {
+            errors[Block] = std::current_exception();
+        }
+    };
+    auto threads = std::vector<std::thread>();
+    threads.reserve(blocks - 1);
+    for (size_t b = 1; b < blocks; ++b) {
+        threads.emplace_back(call, b);
+    }
+    call(0);
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    for (auto & error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+}
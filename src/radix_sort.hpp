@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace qp {
+
+// Stable LSD radix sort by unsigned keys in ascending order: O(n * sizeof(Key)).
+// Order contains indices of Keys, they are reordered so that Keys[Order[i]] don't decrease.
+// Passes over bytes that are equal for all keys are skipped.
+template<class Key>
+void radix_sort(std::vector<size_t> & Order, const std::vector<Key> & Keys) {
+    auto size = Order.size();
+    auto keys = std::vector<Key>(size);
+    for (size_t i = 0; i < size; ++i) {
+        keys[i] = Keys[Order[i]];
+    }
+    auto temp_keys = std::vector<Key>(size);
+    auto temp_order = std::vector<size_t>(size);
+
+    for (size_t shift = 0; shift < sizeof(Key) * 8; shift += 8) {
+        size_t count[257] = {};
+        for (auto key : keys) {
+            ++count[((key >> shift) & 0xFF) + 1];
+        }
+        // All keys have the same byte - nothing to reorder.
+        if (std::any_of(count + 1, count + 257, [size](size_t c) { return c == size; })) continue;
+
+        for (size_t i = 0; i < 256; ++i) {
+            count[i + 1] += count[i];
+        }
+        for (size_t i = 0; i < size; ++i) {
+            auto dst = count[(keys[i] >> shift) & 0xFF]++;
+            temp_keys[dst] = keys[i];
+            temp_order[dst] = Order[i];
+        }
+        keys.swap(temp_keys);
+        Order.swap(temp_order);
+    }
+}
+
+}
@@ -1,35 +1,91 @@
 #include "task.hpp"
+#include "task_arena.hpp"
 
 namespace qp {
 
-task_id task::_static_id = 1;
+std::atomic<task_id> task::_static_id(1);
+thread_local bool task::_is_last_attempt = true;
 
 task::task(int weight) : 
     _weight(weight),
     _id(_static_id++),
-    _parent_id() {}
+    _parent_id(),
+    _parents{ nullptr, nullptr },
+    _dataflow(nullptr),
+    _has_result(false),
+    _result(nullptr),
+    _arguments(nullptr),
+    _argument_count(0) {}
 
 
 
 task::task(int weight, task_id parent_id) : 
     _weight(weight),
     _id(_static_id++),
-    _parent_id( {parent_id} ) {}
+    _parent_id( {parent_id} ),
+    _parents{ _parent_id.data(), _parent_id.data() + _parent_id.size() },
+    _dataflow(nullptr),
+    _has_result(false),
+    _result(nullptr),
+    _arguments(nullptr),
+    _argument_count(0) {}
 
 
 
 task::task(int weight, const std::vector<task_id> & parent_id):
     _weight(weight),
     _id(_static_id++),
-    _parent_id(parent_id) {}
+    _parent_id(parent_id),
+    _parents{ _parent_id.data(), _parent_id.data() + _parent_id.size() },
+    _dataflow(nullptr),
+    _has_result(false),
+    _result(nullptr),
+    _arguments(nullptr),
+    _argument_count(0) {}
 
 
 
+task::task(int weight, id_range parent_id):
+    _weight(weight),
+    _id(_static_id++),
+    _parent_id(),
+    _parents(parent_id),
+    _dataflow(nullptr),
+    _has_result(false),
+    _result(nullptr),
+    _arguments(nullptr),
+    _argument_count(0) {}
+
+
+
+task::task(task_id id, int weight, const std::vector<task_id> & parent_id):
+    _weight(weight),
+    _id(id),
+    _parent_id(parent_id),
+    _parents{ _parent_id.data(), _parent_id.data() + _parent_id.size() },
+    _dataflow(nullptr),
+    _has_result(false),
+    _result(nullptr),
+    _arguments(nullptr),
+    _argument_count(0) {}
+
+
+
+// Moving a vector keeps its buffer, so _parents stays valid.
 task::task(task && task):
     _weight(task._weight),
     _id(task._id),
     _parent_id(std::move(task._parent_id)),
-    _func(std::move(task._func)) {}
+    _parents(task._parents),
+    _func(std::move(task._func)),
+    _dataflow(task._dataflow),
+    _has_result(task._has_result),
+    _result(task._result),
+    _arguments(task._arguments),
+    _argument_count(task._argument_count) {
+    task._arguments = nullptr;
+    task._argument_count = 0;
+}
 
 
 
@@ -37,12 +93,25 @@ task & task::operator=(task && task) {
     _weight = task._weight;
     _id = task._id;
     _parent_id = std::move(task._parent_id);
+    _parents = task._parents;
     _func = std::move(task._func);
+    _dataflow = task._dataflow;
+    _has_result = task._has_result;
+    _result = task._result;
+    if (this != &task) {
+        _free_arguments();
+        _arguments = task._arguments;
+        _argument_count = task._argument_count;
+        task._arguments = nullptr;
+        task._argument_count = 0;
+    }
     return *this;
 }
 
 
-task::~task() {}
+task::~task() {
+    _free_arguments();
+}
 
 
 
@@ -52,8 +121,8 @@ task_id task::id() const {
 
 
 
-std::vector<task_id> task::parents() const {
-    return _parent_id;
+id_range task::parents() const {
+    return _parents;
 }
 
 
@@ -65,9 +134,88 @@ int task::weight() const {
 
 
 void task::execute() {
-    if (_func) {
+    if (_dataflow) {
+        _dataflow(*this);
+    }
+    else if (_func) {
         _func();
     }
 }
 
+
+
+void task::skip() {
+    if (_dataflow) {
+        _release_arguments();
+    }
+}
+
+
+
+task_id task::reserve_ids(size_t Count) {
+    return _static_id.fetch_add(Count);
+}
+
+
+
+void task::_reserve_ids(task_id Id) {
+    auto next = _static_id.load();
+    while (next <= Id && !_static_id.compare_exchange_weak(next, Id + 1)) {}
+}
+
+
+
+bool task::is_dataflow() const {
+    return _dataflow != nullptr;
+}
+
+
+
+bool task::has_result() const {
+    return _has_result;
+}
+
+
+
+void task::link_results(task_result * Result, task_result * const * Arguments, size_t ArgumentCount) {
+    _free_arguments();
+    _result = Result;
+    _arguments = Arguments;
+    _argument_count = ArgumentCount;
+}
+
+
+
+void task::_release_arguments() {
+    for (size_t i = 0; i < _argument_count; ++i) {
+        _arguments[i]->release();
+    }
+}
+
+
+
+// The array of arguments is allocated by a task_arena, its chunk is freed when the last allocation is released.
+void task::_free_arguments() {
+    if (_arguments != nullptr) {
+        task_arena::release(const_cast<task_result **>(_arguments));
+        _arguments = nullptr;
+    }
+}
+
+
+
+void task_deleter::operator()(task * Task) const {
+    if (is_owner) {
+        delete Task;
+    }
+    else {
+        auto parents = Task->parents().first;
+        Task->~task();
+        task_arena::release(Task);
+        if (parents != nullptr) {
+            task_arena::release(const_cast<task_id *>(parents));
+        }
+    }
+}
+
 }
\ No newline at end of file
@@ -3,45 +3,232 @@
 #include <memory>
 #include <functional>
 #include <future>
+#include <atomic>
+#include "task_function.hpp"
+#include "task_result.hpp"
+#include "function_traits.hpp"
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
 
 namespace qp {
 
+typedef unsigned long long task_id;
+
+// A range of tasks' IDs stored contiguously: parents of a task.
+struct id_range {
+public:
+    const task_id * first;
+    const task_id * last;
+
+public:
+    const task_id * begin() const { return first; }
+    const task_id * end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+    const task_id & operator[](size_t i) const { return first[i]; }
+    operator std::vector<task_id>() const { return std::vector<task_id>(first, last); }
+
+};
+
 class task {
 private:
     int _weight;
     task_id _id;
+    // Parents of a task created on the heap are owned by the task, _parents points to them.
     std::vector<task_id> _parent_id;
-    std::function<void()> _func;
-    static task_id _static_id;
+    id_range _parents;
+    task_function _func;
+    static std::atomic<task_id> _static_id;
+
+    // False while a scheduler is going to retry the task executed by the current thread if it throws:
+    // the exception isn't passed to the future then.
+    static thread_local bool _is_last_attempt;
+
+    // Dataflow: set by bind_dataflow and linked to results stored by a task_vector when it is sorted.
+    void (*_dataflow)(task & Task);
+    bool _has_result;
+    task_result * _result;
+    task_result * const * _arguments;
+    size_t _argument_count;
 
 public:
     task(int weight);
     task(int weight, task_id parent_id);
     task(int weight, const std::vector<task_id> & parent_id);
+    // Parents aren't copied: they must outlive the task (e.g. both are allocated in a task_arena).
+    task(int weight, id_range parent_id);
+    // A task with an ID taken from reserve_ids(): tasks created in parallel can refer to each other's IDs.
+    task(task_id id, int weight, const std::vector<task_id> & parent_id);
     task(task && task);
     task & operator=(task && task);
     task(const task & task) = delete;
     task & operator=(const task & task) = delete;
     task_id id() const;
-    std::vector<task_id> parents() const;
+    id_range parents() const;
     int weight() const;
     virtual ~task();
     virtual void execute();
 
+    // Called by schedulers instead of execute() for a task that is skipped: a dataflow task releases its parents'
+    // results, so they are freed by their last consumer as if it had finished.
+    void skip();
+
+    // The result or the exception of the function is passed to the returned future. The exception is thrown
+    // from execute() as well, so schedulers can apply their failure policies.
     template<class Func, class ... Args>
     decltype(auto) bind(Func && func, Args && ... args) {
         using return_type = typename std::invoke_result_t<Func, Args...>;
-        auto task = std::make_shared<std::packaged_task<return_type()>>(
-            std::bind(std::forward<Func>(func), std::forward<Args>(args)...)
-        );
-        std::future<return_type> res = task->get_future();
-        _func = [task](){ (*task)(); };
+        auto promise = std::promise<return_type>();
+        std::future<return_type> res = promise.get_future();
+        _dataflow = nullptr;
+        _has_result = false;
+        _func = [promise = std::move(promise), call = std::bind(std::forward<Func>(func), std::forward<Args>(args)...)]() mutable {
+            try {
+                if constexpr (std::is_void_v<return_type>) {
+                    call();
+                    promise.set_value();
+                }
+                else {
+                    promise.set_value(call());
+                }
+            }
+            catch (...) {
+                if (_is_last_attempt) {
+                    promise.set_exception(std::current_exception());
+                }
+                throw;
+            }
+        };
         return res;
     }
 
+    // Fire-and-forget: no future is created, small functions with their arguments are stored inside the task.
+    // Exceptions are thrown from execute().
+    template<class Func, class ... Args>
+    void bind_detached(Func && func, Args && ... args) {
+        _dataflow = nullptr;
+        _has_result = false;
+        if constexpr (sizeof...(Args) == 0) {
+            _func = std::forward<Func>(func);
+        }
+        else {
+            _func = std::bind(std::forward<Func>(func), std::forward<Args>(args)...);
+        }
+    }
+
+    // Dataflow: the function receives results of the parents that return values as arguments (in order of parents()),
+    // its own result is stored by the task_vector until its children have finished. Arguments taken by lvalue reference
+    // refer to the stored result; arguments taken by value or rvalue reference are moved if the task is the last
+    // consumer of the result, copied otherwise. The function must have a single, non-template operator().
+    template<class Func>
+    void bind_dataflow(Func && func) {
+        using callable = std::decay_t<Func>;
+        _func = std::forward<Func>(func);
+        _dataflow = &task::_invoke_dataflow<callable>;
+        _has_result = !std::is_void_v<typename function_traits<callable>::result>;
+    }
+
+    // Reserves Count consecutive IDs that no task created after this call gets. Returns the first one.
+    static task_id reserve_ids(size_t Count);
+
+    bool is_dataflow() const;
+    bool has_result() const;
+
+    // Used by task_vector: Result is a storage of the task's result (nullptr if it returns nothing),
+    // Arguments - results of its parents allocated by a task_arena (or nullptr): the task releases them
+    // when it is destroyed or linked again.
+    void link_results(task_result * Result, task_result * const * Arguments, size_t ArgumentCount);
+
+private:
+    template<class Func>
+    static void _invoke_dataflow(task & Task) {
+        constexpr auto arity = std::tuple_size_v<typename function_traits<Func>::arguments>;
+        // Arguments are released on failure too, so their results are freed by their last consumer.
+        try {
+            if (Task._argument_count != arity) {
+                throw std::runtime_error(
+                    "A dataflow task takes a different number of arguments than its parents return.");
+            }
+            Task._call_dataflow<Func>(std::make_index_sequence<arity>());
+        }
+        catch (...) {
+            Task._release_arguments();
+            throw;
+        }
+        Task._release_arguments();
+    }
+
+    template<class Func, size_t ... I>
+    void _call_dataflow(std::index_sequence<I...>) {
+        using traits = function_traits<Func>;
+        using result_type = std::decay_t<typename traits::result>;
+        auto & func = _func.target<Func>();
+        if constexpr (std::is_void_v<typename traits::result>) {
+            func(_dataflow_argument<std::tuple_element_t<I, typename traits::arguments>>(*_arguments[I])...);
+        }
+        else if (_result) {
+            _result->emplace<result_type>(
+                func(_dataflow_argument<std::tuple_element_t<I, typename traits::arguments>>(*_arguments[I])...));
+        }
+        else {
+            func(_dataflow_argument<std::tuple_element_t<I, typename traits::arguments>>(*_arguments[I])...);
+        }
+    }
+
+    template<class Arg>
+    static decltype(auto) _dataflow_argument(task_result & Result) {
+        using value_type = std::remove_cv_t<std::remove_reference_t<Arg>>;
+        auto value = Result.get<value_type>();
+        if (!value) {
+            throw std::runtime_error("A dataflow task's argument type differs from its parent's result type.");
+        }
+        if constexpr (std::is_lvalue_reference_v<Arg>) {
+            return *value;
+        }
+        else {
+            // Nobody else can read the result if this task is its last consumer.
+            if (Result.consumers_left() == 1) {
+                return value_type(std::move(*value));
+            }
+            if constexpr (std::is_copy_constructible_v<value_type>) {
+                return value_type(*value);
+            }
+            else {
+                throw std::runtime_error("A result that can't be copied is consumed by value by several tasks.");
+            }
+        }
+    }
+
+    void _release_arguments();
+    void _free_arguments();
+
+    // Tasks of a graph mapped by a task_vector keep the IDs stored in the graph's file.
+    friend class task_vector;
+
+    // Retries of failed tasks.
+    friend class task_manager;
+
+    // IDs of tasks created after this call are greater than Id.
+    static void _reserve_ids(task_id Id);
+
 };
 
-typedef std::unique_ptr<task> task_ptr;
-typedef unsigned long long task_id;
+// Tasks created on the heap are deleted. Tasks created in a task_arena are destroyed and their memory
+// with their parents is released to the arena, which frees a chunk once nothing in it is used.
+struct task_deleter {
+public:
+    bool is_owner = true;
+
+public:
+    task_deleter() = default;
+    task_deleter(bool IsOwner) : is_owner(IsOwner) {}
+    template<class T>
+    task_deleter(const std::default_delete<T> &) {}
+    void operator()(task * Task) const;
+
+};
+
+typedef std::unique_ptr<task, task_deleter> task_ptr;
 
 }
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "task_arena.hpp"
+#include <algorithm>
+
+namespace qp {
+
+task_arena::task_arena(size_t ChunkSize):
+    _chunks(),
+    _chunk(nullptr),
+    _current(nullptr),
+    _left(0),
+    _chunk_size(ChunkSize),
+    _size(0) {}
+
+
+
+task_arena::task_arena(task_arena && TaskArena):
+    _chunks(std::move(TaskArena._chunks)),
+    _chunk(TaskArena._chunk),
+    _current(TaskArena._current),
+    _left(TaskArena._left),
+    _chunk_size(TaskArena._chunk_size),
+    _size(TaskArena._size) {
+    TaskArena._chunk = nullptr;
+    TaskArena.clear();
+}
+
+
+
+task_arena & task_arena::operator=(task_arena && TaskArena) {
+    clear();
+    _chunks = std::move(TaskArena._chunks);
+    _chunk = TaskArena._chunk;
+    _current = TaskArena._current;
+    _left = TaskArena._left;
+    _chunk_size = TaskArena._chunk_size;
+    _size = TaskArena._size;
+    TaskArena._chunk = nullptr;
+    TaskArena.clear();
+    return *this;
+}
+
+
+
+task_arena::~task_arena() {
+    clear();
+}
+
+
+
+// Allocations larger than a chunk get a chunk of their own. The previous chunk loses the arena's reference:
+// it is freed when its last allocation is released.
+void * task_arena::allocate(size_t Size, size_t Alignment) {
+    Alignment = std::max(Alignment, alignof(chunk *));
+    auto padding = (Alignment - ((size_t) _current + sizeof(chunk *)) % Alignment) % Alignment;
+    if (_current == nullptr || sizeof(chunk *) + padding + Size > _left) {
+        auto chunk_size = std::max(_chunk_size, sizeof(chunk *) + Size + Alignment);
+        auto next = std::make_unique<chunk>();
+        next->memory.reset(new char[chunk_size]);
+        next->live = 1;
+        if (_chunk != nullptr) {
+            _release(_chunk);
+        }
+        _chunk = next.get();
+        _chunks.emplace_back(std::move(next));
+        _current = _chunk->memory.get();
+        _left = chunk_size;
+        padding = (Alignment - ((size_t) _current + sizeof(chunk *)) % Alignment) % Alignment;
+    }
+    auto result = _current + sizeof(chunk *) + padding;
+    *reinterpret_cast<chunk **>(result - sizeof(chunk *)) = _chunk;
+    ++_chunk->live;
+    _current += sizeof(chunk *) + padding + Size;
+    _left -= sizeof(chunk *) + padding + Size;
+    _size += Size;
+    return result;
+}
+
+
+
+void task_arena::release(void * Pointer) {
+    _release(*reinterpret_cast<chunk **>(static_cast<char *>(Pointer) - sizeof(chunk *)));
+}
+
+
+
+// Chunks are kept until clear(): the memory of released ones is freed already.
+void task_arena::clear() {
+    if (_chunk != nullptr) {
+        _release(_chunk);
+    }
+    _chunks.clear();
+    _chunk = nullptr;
+    _current = nullptr;
+    _left = 0;
+    _size = 0;
+}
+
+
+
+size_t task_arena::chunk_count() const {
+    return std::count_if(_chunks.begin(), _chunks.end(), [](const std::unique_ptr<chunk> & item) {
+        return item->memory != nullptr;
+    });
+}
+
+
+
+size_t task_arena::size() const {
+    return _size;
+}
+
+
+
+// The one who drops the last reference frees the memory.
+void task_arena::_release(chunk * Chunk) {
+    if (--Chunk->live == 0) {
+        Chunk->memory.reset();
+    }
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <utility>
+#include <new>
+
+namespace qp {
+
+// Bump allocator for tasks and their parents: memory is taken from contiguous chunks.
+// A chunk is freed as soon as all allocations made from it are released and the arena moved on to another chunk,
+// the rest of chunks are freed all at once by clear() or the destructor. Objects aren't destroyed by the arena.
+// Not thread-safe, except release().
+class task_arena {
+private:
+    // Allocations that aren't released yet plus one reference of the arena while the chunk is current.
+    struct chunk {
+        std::unique_ptr<char[]> memory;
+        std::atomic_size_t live;
+    };
+
+    std::vector<std::unique_ptr<chunk>> _chunks;
+    chunk * _chunk;
+    char * _current;
+    size_t _left;
+    size_t _chunk_size;
+    size_t _size;
+
+public:
+    task_arena(size_t ChunkSize = 64 * 1024);
+    task_arena(task_arena && TaskArena);
+    task_arena & operator=(task_arena && TaskArena);
+    task_arena(const task_arena & TaskArena) = delete;
+    task_arena & operator=(const task_arena & TaskArena) = delete;
+    ~task_arena();
+
+    // Each allocation keeps a pointer to its chunk right before the returned memory.
+    void * allocate(size_t Size, size_t Alignment);
+
+    // Releases memory returned by allocate() of any arena. Thread-safe.
+    // Memory that is never released is freed by clear() or the destructor of the arena.
+    static void release(void * Pointer);
+
+    void clear();
+
+    // Number of chunks allocated on the heap.
+    size_t chunk_count() const;
+
+    // Number of bytes taken from chunks since the last clear().
+    size_t size() const;
+
+    template<class T, class ... Args>
+    T * create(Args && ... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+private:
+    static void _release(chunk * Chunk);
+
+};
+
+}
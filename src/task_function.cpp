@@ -0,0 +1,58 @@
+#include "task_function.hpp"
+
+namespace qp {
+
+task_function::task_function():
+    _operations(nullptr) {}
+
+
+
+task_function::task_function(task_function && TaskFunction) noexcept:
+    _operations(TaskFunction._operations) {
+    if (_operations) {
+        _operations->move(_storage, TaskFunction._storage);
+        TaskFunction._operations = nullptr;
+    }
+}
+
+
+
+task_function & task_function::operator=(task_function && TaskFunction) noexcept {
+    if (this == &TaskFunction) return *this;
+    reset();
+    _operations = TaskFunction._operations;
+    if (_operations) {
+        _operations->move(_storage, TaskFunction._storage);
+        TaskFunction._operations = nullptr;
+    }
+    return *this;
+}
+
+
+
+task_function::~task_function() {
+    reset();
+}
+
+
+
+void task_function::operator()() {
+    _operations->invoke(_storage);
+}
+
+
+
+task_function::operator bool() const {
+    return _operations != nullptr;
+}
+
+
+
+void task_function::reset() {
+    if (_operations) {
+        _operations->destroy(_storage);
+        _operations = nullptr;
+    }
+}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace qp {
+
+// A move-only callable without arguments and result. Callables up to inline_size bytes
+// that can be moved without exceptions are stored inside the object, larger ones - on the heap.
+// Callables that take arguments can be stored as well (see task::bind_dataflow): they are called through target(),
+// operator() does nothing for them.
+class task_function {
+public:
+    static constexpr size_t inline_size = 64;
+
+    template<class Func>
+    static constexpr bool is_inline = sizeof(Func) <= inline_size
+                                      && alignof(Func) <= alignof(std::max_align_t)
+                                      && std::is_nothrow_move_constructible_v<Func>;
+
+private:
+    struct operations {
+        void (*invoke)(void * Storage);
+        // Moves a callable from Source storage to Target storage and destroys the one in Source.
+        void (*move)(void * Target, void * Source);
+        void (*destroy)(void * Storage);
+    };
+
+    template<class Func>
+    struct inline_operations {
+        static void invoke(void * Storage) {
+            if constexpr (std::is_invocable_v<Func &>) (*static_cast<Func *>(Storage))();
+        }
+        static void move(void * Target, void * Source) {
+            new (Target) Func(std::move(*static_cast<Func *>(Source)));
+            static_cast<Func *>(Source)->~Func();
+        }
+        static void destroy(void * Storage) { static_cast<Func *>(Storage)->~Func(); }
+        static constexpr operations table = { invoke, move, destroy };
+    };
+
+    // The storage keeps a pointer to the callable.
+    template<class Func>
+    struct heap_operations {
+        static void invoke(void * Storage) {
+            if constexpr (std::is_invocable_v<Func &>) (**static_cast<Func **>(Storage))();
+        }
+        static void move(void * Target, void * Source) { *static_cast<Func **>(Target) = *static_cast<Func **>(Source); }
+        static void destroy(void * Storage) { delete *static_cast<Func **>(Storage); }
+        static constexpr operations table = { invoke, move, destroy };
+    };
+
+    alignas(std::max_align_t) unsigned char _storage[inline_size];
+    const operations * _operations;
+
+public:
+    task_function();
+    task_function(task_function && TaskFunction) noexcept;
+    task_function & operator=(task_function && TaskFunction) noexcept;
+    task_function(const task_function & TaskFunction) = delete;
+    task_function & operator=(const task_function & TaskFunction) = delete;
+    ~task_function();
+
+    template<class Func, class = std::enable_if_t<!std::is_same_v<std::decay_t<Func>, task_function>>>
+    task_function(Func && func) : _operations(nullptr) {
+        _assign(std::forward<Func>(func));
+    }
+
+    template<class Func, class = std::enable_if_t<!std::is_same_v<std::decay_t<Func>, task_function>>>
+    task_function & operator=(Func && func) {
+        reset();
+        _assign(std::forward<Func>(func));
+        return *this;
+    }
+
+    void operator()();
+    explicit operator bool() const;
+    void reset();
+
+    // The stored callable. Func must be the decayed type of the callable that was assigned.
+    template<class Func>
+    Func & target() {
+        if constexpr (is_inline<Func>) {
+            return *reinterpret_cast<Func *>(_storage);
+        }
+        else {
+            return **reinterpret_cast<Func **>(_storage);
+        }
+    }
+
+private:
+    template<class Func>
+    void _assign(Func && func) {
+        using callable = std::decay_t<Func>;
+        if constexpr (is_inline<callable>) {
+            new (_storage) callable(std::forward<Func>(func));
+            _operations = &inline_operations<callable>::table;
+        }
+        else {
+            *reinterpret_cast<callable **>(_storage) = new callable(std::forward<Func>(func));
+            _operations = &heap_operations<callable>::table;
+        }
+    }
+
+};
+
+}
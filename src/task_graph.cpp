@@ -0,0 +1,205 @@
+#include "task_graph.hpp"
+#include "parallel_for.hpp"
+#include <algorithm>
+#include <atomic>
+
+namespace qp {
+
+bool task_graph::build(const std::vector<task_ptr> & Tasks, id_index & Positions, int ThreadCount) {
+    auto count = Tasks.size();
+    auto ids = std::vector<task_id>(count);
+    parallel_for(count, ThreadCount, [&](size_t First, size_t Last) {
+        for (auto i = First; i < Last; ++i) {
+            ids[i] = Tasks[i]->id();
+        }
+    });
+    if (!Positions.build(ids, ThreadCount)) return false;
+
+    // Parents' rows: the only place where IDs are resolved. Each thread fills the rows of its block of tasks.
+    parent_offset.assign(count + 1, 0);
+    parallel_for(count, ThreadCount, [&](size_t First, size_t Last) {
+        for (auto i = First; i < Last; ++i) {
+            parent_offset[i + 1] = Tasks[i]->parents().size();
+        }
+    });
+    for (size_t i = 0; i < count; ++i) {
+        parent_offset[i + 1] += parent_offset[i];
+    }
+    parent_index.resize(parent_offset.back());
+    std::atomic_bool is_complete(true);
+    parallel_for(count, ThreadCount, [&](size_t First, size_t Last) {
+        auto it = parent_index.begin() + parent_offset[First];
+        for (auto i = First; i < Last; ++i) {
+            for (auto par_id : Tasks[i]->parents()) {
+                auto pos = Positions.find(par_id);
+                if (pos == id_index::npos) {
+                    is_complete = false;
+                    return;
+                }
+                *it++ = pos;
+            }
+        }
+    });
+    if (!is_complete) return false;
+
+    build_children(ThreadCount);
+    return true;
+}
+
+
+
+std::vector<size_t> task_graph::permute(const std::vector<size_t> & Order, int ThreadCount) {
+    auto count = Order.size();
+    auto new_position = std::vector<size_t>(count);
+    parallel_for(count, ThreadCount, [&](size_t First, size_t Last) {
+        for (auto i = First; i < Last; ++i) {
+            new_position[Order[i]] = i;
+        }
+    });
+
+    auto offset = std::vector<size_t>(count + 1, 0);
+    parallel_for(count, ThreadCount, [&](size_t First, size_t Last) {
+        for (auto i = First; i < Last; ++i) {
+            offset[i + 1] = parents(Order[i]).size();
+        }
+    });
+    for (size_t i = 0; i < count; ++i) {
+        offset[i + 1] += offset[i];
+    }
+    auto index = std::vector<size_t>(offset.back());
+    parallel_for(count, ThreadCount, [&](size_t First, size_t Last) {
+        auto it = index.begin() + offset[First];
+        for (auto i = First; i < Last; ++i) {
+            for (auto par_pos : parents(Order[i])) {
+                *it++ = new_position[par_pos];
+            }
+        }
+    });
+    parent_offset.swap(offset);
+    parent_index.swap(index);
+
+    build_children(ThreadCount);
+    return new_position;
+}
+
+
+
+void task_graph::order_parents(int ThreadCount) {
+    if (ThreadCount > 1) {
+        parallel_for(size(), ThreadCount, [this](size_t First, size_t Last) {
+            for (auto i = First; i < Last; ++i) {
+                std::sort(parent_index.begin() + parent_offset[i], parent_index.begin() + parent_offset[i + 1]);
+            }
+        });
+        return;
+    }
+
+    // Children's rows are complete: walk them in ascending order of parents.
+    auto next = std::vector<size_t>(parent_offset.begin(), parent_offset.end() - 1);
+    for (size_t i = 0; i < size(); ++i) {
+        for (auto child : children(i)) {
+            parent_index[next[child]++] = i;
+        }
+    }
+}
+
+
+
+position_range task_graph::parents(size_t Position) const {
+    auto data = parent_index.data();
+    return { data + parent_offset[Position], data + parent_offset[Position + 1] };
+}
+
+
+
+position_range task_graph::children(size_t Position) const {
+    auto data = child_index.data();
+    return { data + child_offset[Position], data + child_offset[Position + 1] };
+}
+
+
+
+// Children's rows are left after release_parents().
+size_t task_graph::size() const {
+    auto & offset = parent_offset.empty() ? child_offset : parent_offset;
+    return offset.empty() ? 0 : offset.size() - 1;
+}
+
+
+
+void task_graph::release_parents() {
+    std::vector<size_t>().swap(parent_offset);
+    std::vector<size_t>().swap(parent_index);
+}
+
+
+
+void task_graph::clear() {
+    parent_offset.clear();
+    parent_index.clear();
+    child_offset.clear();
+    child_index.clear();
+}
+
+
+
+void task_graph::build_children(int ThreadCount) {
+    auto count = size();
+    if (ThreadCount > 1) {
+        _build_children_parallel(ThreadCount);
+        return;
+    }
+
+    // Count children of each task.
+    child_offset.assign(count + 1, 0);
+    for (auto par_pos : parent_index) {
+        ++child_offset[par_pos + 1];
+    }
+    for (size_t i = 0; i < count; ++i) {
+        child_offset[i + 1] += child_offset[i];
+    }
+
+    // Place children in ascending order.
+    child_index.resize(parent_index.size());
+    auto next = std::vector<size_t>(child_offset.begin(), child_offset.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        for (auto par_pos : parents(i)) {
+            child_index[next[par_pos]++] = i;
+        }
+    }
+}
+
+
+
+// Children are counted and placed with atomic counters, so they are placed in any order: rows are sorted afterwards
+// to be the same as the serial ones.
+void task_graph::_build_children_parallel(int ThreadCount) {
+    auto count = size();
+    auto next = std::vector<std::atomic_size_t>(count);
+    parallel_for(parent_index.size(), ThreadCount, [&](size_t First, size_t Last) {
+        for (auto i = First; i < Last; ++i) {
+            next[parent_index[i]].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    child_offset.assign(count + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        child_offset[i + 1] = child_offset[i] + next[i].load(std::memory_order_relaxed);
+        next[i].store(child_offset[i], std::memory_order_relaxed);
+    }
+
+    child_index.resize(parent_index.size());
+    parallel_for(count, ThreadCount, [&](size_t First, size_t Last) {
+        for (auto i = First; i < Last; ++i) {
+            for (auto par_pos : parents(i)) {
+                child_index[next[par_pos].fetch_add(1, std::memory_order_relaxed)] = i;
+            }
+        }
+    });
+    parallel_for(count, ThreadCount, [&](size_t First, size_t Last) {
+        for (auto i = First; i < Last; ++i) {
+            std::sort(child_index.begin() + child_offset[i], child_index.begin() + child_offset[i + 1]);
+        }
+    });
+}
+
+}
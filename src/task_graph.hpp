@@ -0,0 +1,63 @@
+#pragma once
+#include "task.hpp"
+#include "id_index.hpp"
+#include <vector>
+
+namespace qp {
+
+// A range of tasks' positions stored contiguously in a task_graph.
+struct position_range {
+public:
+    const size_t * first;
+    const size_t * last;
+
+public:
+    const size_t * begin() const { return first; }
+    const size_t * end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+
+};
+
+// Relationships between tasks compiled into compressed sparse rows (CSR).
+// Parents of a task at position i are stored in parent_index[parent_offset[i] .. parent_offset[i+1]),
+// children - in child_index[child_offset[i] .. child_offset[i+1]). Children are stored in ascending order.
+struct task_graph {
+public:
+    std::vector<size_t> parent_offset;
+    std::vector<size_t> parent_index;
+    std::vector<size_t> child_offset;
+    std::vector<size_t> child_index;
+
+public:
+    // Resolves parents' IDs of the tasks to positions and fills both parents' and children's rows.
+    // Fills Positions with tasks' positions by their IDs. Rows are filled by ThreadCount threads,
+    // the result doesn't depend on the number of threads.
+    // Returns false if IDs repeat or not all parents are present in Tasks.
+    bool build(const std::vector<task_ptr> & Tasks, id_index & Positions, int ThreadCount = 1);
+
+    // Moves a task from position Order[i] to position i and updates relationships accordingly.
+    // Returns new positions by old positions.
+    std::vector<size_t> permute(const std::vector<size_t> & Order, int ThreadCount = 1);
+
+    // Sorts parents' rows in ascending order of positions: O(n+v) by one thread, rows are sorted one by one
+    // by several threads.
+    void order_parents(int ThreadCount = 1);
+
+    // Fills children's rows from parents' rows, in ascending order.
+    void build_children(int ThreadCount = 1);
+
+    // Frees parents' rows: dispatching needs only children's ones.
+    void release_parents();
+
+    position_range parents(size_t Position) const;
+    position_range children(size_t Position) const;
+    size_t size() const;
+    void clear();
+
+private:
+    void _build_children_parallel(int ThreadCount);
+
+};
+
+}
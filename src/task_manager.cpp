@@ -2,17 +2,30 @@
 
 namespace qp {
 
-task_manager::task_manager(task_vector && TaskVector, int ThreadCount) :
+thread_local const task_manager * task_manager::_current_manager = nullptr;
+thread_local int task_manager::_current_worker = 0;
+thread_local cancel_token task_manager::_current_token;
+
+
+task_manager::task_manager(task_vector && TaskVector, int ThreadCount, schedule_mode Mode, sort_algorithm Algorithm) :
     _thread_count(std::max(1, ThreadCount)),
+    _mode(Mode),
+    _algorithm(Algorithm),
     _task_vector(std::move(TaskVector)),
     _on_hold(false),
-    _is_running(false) {}
+    _is_running(false),
+    _tasks_left(0),
+    _idle_count(0),
+    _wake_epoch(0),
+    _next_queue(0),
+    _is_cancelled(false),
+    _policy(failure_policy::skip_dependents),
+    _retries(0) {}
 
 
 
 task_manager::~task_manager() {
-    _is_running = false;
-    _cv.notify_all();
+    _stop();
     _join_threads();
 }
 
@@ -20,17 +33,170 @@ task_manager::~task_manager() {
 
 void task_manager::run() {
     if (_is_running) return;
-    if (!_task_vector.sort()) {
-        throw std::runtime_error("Not all parents are present in a task_vector.");
+    if (!_task_vector.is_sorted() && !_task_vector.sort(_algorithm, _thread_count)) {
+        throw std::runtime_error(_task_vector.sort_error());
     };
+    // Nothing to execute.
+    if (_task_vector.size() == 0) return;
+
+    if (QP_TRACE && _trace.is_enabled()) {
+        _trace.start(_thread_count, _task_vector.size());
+    }
+    if (_metrics.is_enabled()) {
+        auto path = _task_vector.critical_path();
+        auto weights = std::vector<int>();
+        for (auto pos : path) {
+            weights.push_back(_task_vector.weight(pos));
+        }
+        _metrics.start(_thread_count, _task_vector.size(), _task_vector.ready_count(), std::move(path),
+                       std::move(weights));
+    }
+    if (_mode == schedule_mode::work_stealing) {
+        _prepare_queues();
+    }
+    // Tasks may be submitted from now on.
+    _tasks_left = _task_vector.size();
     _is_running = true;
     _launch_thread_pool();
 }
 
 
 
-void task_manager::wait() {
+// Thread-safe.
+void task_manager::submit(task_ptr Task) {
+    if (_is_cancelled) {
+        _skip(Task->id());
+        return;
+    }
+    // Count the task as unfinished before adding it, so the graph can't be finished meanwhile.
+    auto left = _tasks_left.load();
+    do {
+        if (left == 0) {
+            throw std::runtime_error("task_manager is not running.");
+        }
+    } while (!_tasks_left.compare_exchange_weak(left, left + 1));
+
+    auto is_submitted = false;
+    if (_mode == schedule_mode::work_stealing) {
+        auto ready = std::vector<size_t>();
+        is_submitted = _task_vector.submit(std::move(Task), ready);
+        if (_metrics.is_enabled()) {
+            _metrics.add_submitted_ready(ready.size());
+        }
+        if (!ready.empty()) {
+            // A task submitted by a worker stays with it, otherwise the queues are taken in turn.
+            auto worker = (_current_manager == this) ? _current_worker : (int) (_next_queue++ % _thread_count);
+            _queues[worker]->push(ready);
+            _wake_idle();
+        }
+    }
+    else {
+        {
+            std::lock_guard<std::mutex> lock(_task_vector_mutex);
+            is_submitted = _task_vector.submit(std::move(Task));
+            if (_metrics.is_enabled()) {
+                _metrics.add_submitted_ready(_task_vector.released().size());
+            }
+            _on_hold = false;
+        }
+        _cv.notify_one();
+    }
+
+    if (!is_submitted) {
+        if (--_tasks_left == 0) {
+            _stop();
+        }
+        throw std::runtime_error("Not all parents of the submitted task are present in a task_vector.");
+    }
+}
+
+
+
+failure_report task_manager::wait() {
     _join_threads();
+    auto report = failure_report();
+    report.skipped = skipped();
+    report.is_cancelled = _is_cancelled;
+    std::lock_guard<std::mutex> lock(_report_mutex);
+    report.failures = _failures;
+    return report;
+}
+
+
+
+void task_manager::set_failure_policy(failure_policy Policy, int Retries) {
+    _policy = Policy;
+    _retries = std::max(Retries, 0);
+}
+
+
+
+task_trace & task_manager::trace() {
+    return _trace;
+}
+
+
+
+task_metrics & task_manager::metrics() {
+    return _metrics;
+}
+
+
+
+// Done statuses of sorted tasks are atomic: the critical path is checked without locks.
+run_metrics task_manager::poll_metrics() const {
+    return _metrics.snapshot(_tasks_left, [this](size_t Position) { return _task_vector.is_done(Position); });
+}
+
+
+
+// Children's rows are kept after dispatching: the span is found over the sorted tasks with their measured durations.
+run_report task_manager::report() const {
+    auto & durations = _metrics.durations();
+    std::uint64_t span = 0;
+    for (auto pos : _task_vector.critical_path(durations)) {
+        span += durations[pos];
+    }
+    return _metrics.report(span);
+}
+
+
+
+// Running tasks may keep submitting tasks: these are skipped as well.
+void task_manager::cancel() {
+    _is_cancelled = true;
+    _stop();
+}
+
+
+
+bool task_manager::cancel(task_id Id) {
+    return _task_vector.cancel(Id);
+}
+
+
+
+// Tasks that weren't dispatched before the graph was cancelled aren't done: they are skipped as well.
+std::vector<task_id> task_manager::skipped() const {
+    auto out = std::vector<task_id>();
+    {
+        std::lock_guard<std::mutex> lock(_report_mutex);
+        out = _skipped;
+    }
+    if (_is_cancelled && !_thread_pool.empty()) {
+        for (size_t pos = 0; pos < _task_vector.size(); ++pos) {
+            if (!_task_vector.is_done(pos)) {
+                out.push_back(_task_vector.id(pos));
+            }
+        }
+    }
+    return out;
+}
+
+
+
+cancel_token task_manager::current_token() {
+    return _current_token;
 }
 
 
@@ -39,9 +205,16 @@ void task_manager::_launch_thread_pool() {
     // Create required number of workers.
     // And start executing tasks in a loop.
     for (int i = 0; i < _thread_count; ++i) {
-        _thread_pool.emplace_back(
-            [this] { _start_infinite_loop(); }
-        );
+        if (_mode == schedule_mode::work_stealing) {
+            _thread_pool.emplace_back(
+                [this, i] { _start_stealing_loop(i); }
+            );
+        }
+        else {
+            _thread_pool.emplace_back(
+                [this, i] { _start_infinite_loop(i); }
+            );
+        }
     }
 }
 
@@ -57,6 +230,55 @@ void task_manager::_join_threads() {
 
 
 
+void task_manager::_stop() {
+    if (_metrics.is_enabled()) {
+        _metrics.finish();
+    }
+    std::lock_guard<std::mutex> lock(_task_vector_mutex);
+    _is_running = false;
+    _cv.notify_all();
+}
+
+
+
+void task_manager::_skip(task_id Id) {
+    std::lock_guard<std::mutex> lock(_report_mutex);
+    _skipped.push_back(Id);
+}
+
+
+
+// Returns false if the task failed on its last attempt. The failed task is cancelled: its children get
+// the status when it's done (or the whole graph is cancelled), so they are skipped.
+bool task_manager::_execute(task & Task) {
+    auto retries = Task.is_dataflow() ? 0 : _retries;
+    for (auto attempt = 1; ; ++attempt) {
+        try {
+            task::_is_last_attempt = attempt > retries;
+            Task.execute();
+            task::_is_last_attempt = true;
+            return true;
+        }
+        catch (...) {
+            if (attempt <= retries) continue;
+            task::_is_last_attempt = true;
+            {
+                std::lock_guard<std::mutex> lock(_report_mutex);
+                _failures.push_back({ Task.id(), attempt, std::current_exception(), describe_current_exception() });
+            }
+            if (_policy == failure_policy::abort) {
+                cancel();
+            }
+            else {
+                _task_vector.cancel(Task.id());
+            }
+            return false;
+        }
+    }
+}
+
+
+
 void task_manager::_pass_the_torch() {
     _on_hold.exchange(false);
     _cv.notify_one();
@@ -64,37 +286,264 @@ void task_manager::_pass_the_torch() {
 
 
 
-void task_manager::_start_infinite_loop() {
+// With tracing, a task is stamped when it's popped, started and finished; its children are stamped as ready
+// under the lock that releases them. With metrics, time is counted from one step of the loop to the next one.
+void task_manager::_start_infinite_loop(int Worker) {
+    auto is_traced = QP_TRACE && _trace.is_enabled();
+    trace_record rec = {};
+    auto is_measured = _metrics.is_enabled();
+    auto counters = is_measured ? &_metrics.worker(Worker) : nullptr;
+    std::uint64_t time = 0;
     while (_is_running) {
         task_ptr temp_task;
+        size_t temp_position;
         {
             // Wait for notificiation and try acquire _on_hold.
+            if (is_measured) {
+                time = _metrics.now();
+            }
             std::unique_lock<std::mutex> lock(_task_vector_mutex);
+            if (is_measured) {
+                time = _metrics.lap(counters->lock_wait, time);
+            }
             this->_cv.wait(lock, [this]{ return !this->_is_running || !this->_on_hold.exchange(true); });
+            if (is_measured) {
+                _metrics.lap(counters->idle, time);
+            }
 
             // If thread pool is running - try to pick a new task.
+            // The pool is stopped when the last task is done: running tasks may submit new ones.
             if (_is_running) {
-                // Try to get next task.
-                // If false returned (the last task was returned), say stop to other threads.
-                if (!_task_vector.pop_next(temp_task)) {
-                    _is_running = false;
-                    _cv.notify_all();
-                }
+                _task_vector.pop_next(temp_task, temp_position);
             }
             else return;
         }
 
         // If there is a task to be executed.
         if (temp_task != nullptr) {
+            if (is_traced) {
+                rec.dispatch = _trace.now();
+            }
+            if (is_measured) {
+                worker_counters::add(counters->dispatched, 1);
+                _metrics.dispatched();
+            }
             // Give a way to another thread.
             _pass_the_torch();
-            // Start executing the task and mark it as done.
-            temp_task->execute();
-            _task_vector.set_done(temp_task->id());
+            // Tasks of a cancelled graph or subtree are done without being executed.
+            auto is_skipped = _is_cancelled || _task_vector.is_cancelled(temp_position);
+            if (is_skipped) {
+                _skip(temp_task->id());
+                temp_task->skip();
+                temp_task.reset();
+                if (is_measured) {
+                    time = _metrics.now();
+                }
+            }
+            else {
+                // Start executing the task and mark it as done.
+                // The task with its captured arguments is freed before its children are released.
+                if (is_traced) {
+                    rec.id = temp_task->id();
+                    rec.start = _trace.now();
+                }
+                if (is_measured) {
+                    time = _metrics.now();
+                }
+                _current_token = cancel_token(_is_cancelled, _task_vector, temp_position);
+                _execute(*temp_task);
+                temp_task.reset();
+                _current_token = cancel_token();
+                if (is_measured) {
+                    auto start = time;
+                    time = _metrics.lap(counters->busy, time);
+                    _metrics.set_duration(temp_position, time - start);
+                }
+                if (is_traced) {
+                    rec.end = _trace.now();
+                    rec.position = temp_position;
+                    rec.worker = Worker;
+                    rec.ready = _trace.ready(temp_position, rec.dispatch);
+                    _trace.record(Worker, rec);
+                }
+            }
+            {
+                // Children become ready in the task vector - it must be protected.
+                std::lock_guard<std::mutex> lock(_task_vector_mutex);
+                if (is_measured) {
+                    _metrics.lap(counters->lock_wait, time);
+                }
+                _task_vector.set_done(temp_position);
+                if (is_traced) {
+                    auto ready_time = _trace.now();
+                    for (auto child : _task_vector.released()) {
+                        _trace.set_ready(child, ready_time);
+                    }
+                }
+                if (is_measured) {
+                    worker_counters::add(counters->released, _task_vector.released().size());
+                    worker_counters::add(counters->executed, is_skipped ? 0 : 1);
+                }
+            }
+            // The last task is done - say stop to other threads.
+            if (--_tasks_left == 0) {
+                _stop();
+                return;
+            }
             // In case all threads are staying on hold - notify one of them.
             _pass_the_torch();
         }
     }
 }
 
+
+
+
+void task_manager::_prepare_queues() {
+    _queues.clear();
+    for (int i = 0; i < _thread_count; ++i) {
+        _queues.emplace_back(std::make_unique<worker_queue>());
+    }
+    _idle_count = 0;
+    _wake_epoch = 0;
+    _next_queue = 0;
+
+    // Deal parentless tasks to workers one by one keeping sorted order in each queue.
+    auto roots = std::vector<size_t>();
+    _task_vector.pop_ready(roots);
+    auto dealt = std::vector<std::vector<size_t>>(_thread_count);
+    for (size_t i = 0; i < roots.size(); ++i) {
+        dealt[i % _thread_count].push_back(roots[i]);
+    }
+    for (int i = 0; i < _thread_count; ++i) {
+        _queues[i]->push(dealt[i]);
+    }
+}
+
+
+
+void task_manager::_start_stealing_loop(int Worker) {
+    _current_manager = this;
+    _current_worker = Worker;
+    auto & own = *_queues[Worker];
+    auto ready = std::vector<size_t>();
+    size_t pos;
+    auto is_traced = QP_TRACE && _trace.is_enabled();
+    trace_record rec = {};
+    auto is_measured = _metrics.is_enabled();
+    auto counters = is_measured ? &_metrics.worker(Worker) : nullptr;
+    std::uint64_t time = 0;
+    while (_is_running) {
+        // Remember the epoch before looking for a task: a push after that will not be missed.
+        auto epoch = _wake_epoch.load();
+
+        // Take own task first, otherwise try to steal one.
+        if (own.pop(pos) || _steal(Worker, pos)) {
+            if (is_traced) {
+                rec.dispatch = _trace.now();
+            }
+            if (is_measured) {
+                worker_counters::add(counters->dispatched, 1);
+                _metrics.dispatched();
+            }
+            // The task is freed right after execution, before its children are released.
+            // Tasks of a cancelled graph or subtree are done without being executed.
+            auto tsk = _task_vector.take(pos);
+            auto is_skipped = _is_cancelled || _task_vector.is_cancelled(pos);
+            if (is_skipped) {
+                _skip(tsk->id());
+                tsk->skip();
+                tsk.reset();
+            }
+            else {
+                if (is_traced) {
+                    rec.id = tsk->id();
+                    rec.start = _trace.now();
+                }
+                if (is_measured) {
+                    time = _metrics.now();
+                }
+                _current_token = cancel_token(_is_cancelled, _task_vector, pos);
+                _execute(*tsk);
+                tsk.reset();
+                _current_token = cancel_token();
+                if (is_measured) {
+                    _metrics.set_duration(pos, _metrics.lap(counters->busy, time) - time);
+                }
+                if (is_traced) {
+                    rec.end = _trace.now();
+                    rec.position = pos;
+                    rec.worker = Worker;
+                    rec.ready = _trace.ready(pos, rec.dispatch);
+                    _trace.record(Worker, rec);
+                }
+            }
+
+            // Released children stay with this worker, the rest of workers are woken up to steal
+            // if there is more than one task to do.
+            ready.clear();
+            _task_vector.set_done(pos, ready);
+            if (is_traced) {
+                auto ready_time = _trace.now();
+                for (auto child : ready) {
+                    _trace.set_ready(child, ready_time);
+                }
+            }
+            if (is_measured) {
+                worker_counters::add(counters->released, ready.size());
+                worker_counters::add(counters->executed, is_skipped ? 0 : 1);
+            }
+            if (!ready.empty() && own.push(ready) > 1) {
+                _wake_idle();
+            }
+
+            // The last task is done - say stop to other threads.
+            if (--_tasks_left == 0) {
+                _stop();
+            }
+        }
+        else {
+            _wait_for_work(Worker, epoch);
+        }
+    }
+}
+
+
+
+bool task_manager::_steal(int Worker, size_t & OutPosition) {
+    for (int i = 1; i < _thread_count; ++i) {
+        if (_queues[(Worker + i) % _thread_count]->steal(OutPosition)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+void task_manager::_wait_for_work(int Worker, size_t Epoch) {
+    auto is_measured = _metrics.is_enabled();
+    std::uint64_t time = is_measured ? _metrics.now() : 0;
+    std::unique_lock<std::mutex> lock(_task_vector_mutex);
+    if (is_measured) {
+        time = _metrics.lap(_metrics.worker(Worker).lock_wait, time);
+    }
+    ++_idle_count;
+    _cv.wait(lock, [this, Epoch]{ return !_is_running || _wake_epoch != Epoch; });
+    --_idle_count;
+    if (is_measured) {
+        _metrics.lap(_metrics.worker(Worker).idle, time);
+    }
+}
+
+
+
+void task_manager::_wake_idle() {
+    ++_wake_epoch;
+    if (_idle_count > 0) {
+        std::lock_guard<std::mutex> lock(_task_vector_mutex);
+        _cv.notify_all();
+    }
+}
+
 }
\ No newline at end of file
@@ -1,6 +1,11 @@
 #pragma once
 #include "task.hpp"
 #include "task_vector.hpp"
+#include "worker_queue.hpp"
+#include "task_trace.hpp"
+#include "task_metrics.hpp"
+#include "cancel_token.hpp"
+#include "failure_report.hpp"
 #include <thread>
 #include <atomic>
 #include <condition_variable>
@@ -8,9 +13,27 @@
 
 namespace qp {
 
+enum class schedule_mode {
+    // All workers take tasks from one ready queue protected by a mutex.
+    shared_queue,
+    // Each worker has its own queue: released children stay with the worker that finished their parent,
+    // idle workers steal from the others.
+    work_stealing
+};
+
+// What happens when a task throws on its last attempt.
+enum class failure_policy {
+    // The graph is cancelled: running tasks are finished, the rest are skipped.
+    abort,
+    // Descendants of the failed task are skipped, the rest of the graph is executed.
+    skip_dependents
+};
+
 class task_manager {
 private:
     int _thread_count;
+    schedule_mode _mode;
+    sort_algorithm _algorithm;
     task_vector _task_vector;
     std::mutex _task_vector_mutex;
     std::atomic_bool _is_running;
@@ -18,20 +41,97 @@ private:
     std::condition_variable _cv;
     std::vector<std::thread> _thread_pool;
 
+    // Number of tasks that aren't done yet.
+    std::atomic_size_t _tasks_left;
+
+    // Work stealing.
+    std::vector<std::unique_ptr<worker_queue>> _queues;
+    std::atomic_int _idle_count;
+    std::atomic_size_t _wake_epoch;
+    std::atomic_size_t _next_queue;
+
+    // Records of executed tasks, if enabled.
+    task_trace _trace;
+
+    // Live counters of workers, if enabled.
+    task_metrics _metrics;
+
+    // Cancellation of the whole graph and IDs of the tasks skipped at dispatch or submission.
+    std::atomic_bool _is_cancelled;
+    mutable std::mutex _report_mutex;
+    std::vector<task_id> _skipped;
+
+    // Failed tasks are executed again up to _retries times, then the policy is applied.
+    failure_policy _policy;
+    int _retries;
+    std::vector<task_failure> _failures;
+
+    // Worker's manager and index for the current thread.
+    static thread_local const task_manager * _current_manager;
+    static thread_local int _current_worker;
+
+    // Token of the task executed by the current thread.
+    static thread_local cancel_token _current_token;
+
 public:
-    task_manager(task_vector && TaskVector, int ThreadCount = 1);
+    task_manager(task_vector && TaskVector, int ThreadCount = 1, schedule_mode Mode = schedule_mode::shared_queue,
+                 sort_algorithm Algorithm = sort_algorithm::linear);
     task_manager(const task_manager & TaskManager) = delete;
     task_manager & operator=(const task_manager & TaskManager) = delete;
     void run();
-    void wait();
+    void submit(task_ptr Task);
+
+    // Waits for the tasks and joins the threads. Returns failures and skipped tasks of the run.
+    failure_report wait();
     virtual ~task_manager();
 
+    // Tasks that throw are executed again up to Retries times (except dataflow tasks: their arguments are consumed),
+    // then the Policy is applied. Futures get the exception of the last attempt. Call it before run().
+    void set_failure_policy(failure_policy Policy, int Retries = 0);
+
+    // Tracing of executed tasks: enable it before run(), read the records after wait().
+    task_trace & trace();
+
+    // Live metrics: enable them before run(), then poll_metrics() may be called by any thread while the graph runs.
+    task_metrics & metrics();
+    run_metrics poll_metrics() const;
+
+    // Work, span and achieved speedup of the run from the durations measured with metrics enabled. Call it after wait().
+    run_report report() const;
+
+    // Stops dispatching: running tasks are finished (they may poll their tokens), the rest are skipped. Thread-safe.
+    void cancel();
+
+    // Skips the task and its descendants that haven't started yet. Returns false if there is no such task.
+    // Thread-safe, call it after run().
+    bool cancel(task_id Id);
+
+    // IDs of the tasks that were skipped because of cancellation. Call it after wait().
+    std::vector<task_id> skipped() const;
+
+    // Token of the task executed by the calling thread, a default (never cancelled) token outside of tasks.
+    static cancel_token current_token();
+
+    // Result of a dataflow task, see task_vector::result. Call it after wait().
+    template<class T>
+    T * result(task_id Id) {
+        return _task_vector.result<T>(Id);
+    }
+
 private:
     void _launch_thread_pool();
     void _join_threads();
+    void _stop();
     void _pass_the_torch();
-    void _start_infinite_loop();
+    void _skip(task_id Id);
+    bool _execute(task & Task);
+    void _start_infinite_loop(int Worker);
+    void _prepare_queues();
+    void _start_stealing_loop(int Worker);
+    bool _steal(int Worker, size_t & OutPosition);
+    void _wait_for_work(int Worker, size_t Epoch);
+    void _wake_idle();
     
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,174 @@
+#include "task_metrics.hpp"
+#include <algorithm>
+
+namespace qp {
+
+task_metrics::task_metrics():
+    _is_enabled(false),
+    _origin(std::chrono::steady_clock::now()),
+    _workers(),
+    _worker_count(0),
+    _initial_ready(0),
+    _submitted_ready(0),
+    _critical_path(),
+    _critical_weights(),
+    _durations(),
+    _first_dispatch(0),
+    _finished(0) {}
+
+
+
+void task_metrics::enable() {
+    _is_enabled = true;
+}
+
+
+
+void task_metrics::disable() {
+    _is_enabled = false;
+}
+
+
+
+bool task_metrics::is_enabled() const {
+    return _is_enabled;
+}
+
+
+
+void task_metrics::start(int WorkerCount, size_t TaskCount, size_t ReadyCount, std::vector<size_t> CriticalPath,
+                         std::vector<int> CriticalWeights) {
+    _worker_count = std::max(WorkerCount, 1);
+    _workers.reset(new worker_counters[_worker_count]);
+    for (int i = 0; i < _worker_count; ++i) {
+        auto & counters = _workers[i];
+        for (auto counter : { &counters.executed, &counters.dispatched, &counters.released,
+                              &counters.busy, &counters.idle, &counters.lock_wait }) {
+            counter->store(0, std::memory_order_relaxed);
+        }
+    }
+    _initial_ready = ReadyCount;
+    _submitted_ready = 0;
+    _critical_path = std::move(CriticalPath);
+    _critical_weights = std::move(CriticalWeights);
+    _durations.assign(TaskCount, 0);
+    _first_dispatch = 0;
+    _finished = 0;
+    _origin = std::chrono::steady_clock::now();
+}
+
+
+
+// Only the first call writes: later ones just read a line that isn't modified anymore.
+void task_metrics::dispatched() {
+    if (_first_dispatch.load(std::memory_order_relaxed) == 0) {
+        std::uint64_t none = 0;
+        _first_dispatch.compare_exchange_strong(none, std::max(now(), (std::uint64_t) 1));
+    }
+}
+
+
+
+void task_metrics::finish() {
+    std::uint64_t running = 0;
+    _finished.compare_exchange_strong(running, std::max(now(), (std::uint64_t) 1));
+}
+
+
+
+std::uint64_t task_metrics::now() const {
+    return (std::uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - _origin).count();
+}
+
+
+
+worker_counters & task_metrics::worker(int Worker) {
+    return _workers[Worker];
+}
+
+
+
+std::uint64_t task_metrics::lap(std::atomic<std::uint64_t> & Counter, std::uint64_t Since) const {
+    auto time = now();
+    worker_counters::add(Counter, time - Since);
+    return time;
+}
+
+
+
+void task_metrics::add_submitted_ready(size_t Count) {
+    _submitted_ready.fetch_add(Count, std::memory_order_relaxed);
+}
+
+
+
+void task_metrics::set_duration(size_t Position, std::uint64_t Duration) {
+    if (Position < _durations.size()) {
+        _durations[Position] = Duration;
+    }
+}
+
+
+
+const std::vector<std::uint64_t> & task_metrics::durations() const {
+    return _durations;
+}
+
+
+
+// The overhead is counted from the first dispatch: starting threads and computing the critical path before it
+// aren't the scheduler's cost per task.
+run_report task_metrics::report(std::uint64_t Span) const {
+    auto out = run_report();
+    auto snapshot = _snapshot(0);
+    out.thread_count = _worker_count;
+    out.task_count = snapshot.done;
+    out.elapsed = snapshot.elapsed;
+    out.work = 0;
+    out.idle = 0;
+    out.lock_wait = 0;
+    for (auto & worker : snapshot.workers) {
+        out.work += worker.busy;
+        out.idle += worker.idle;
+        out.lock_wait += worker.lock_wait;
+    }
+    auto first_dispatch = _first_dispatch.load() / 1e9;
+    auto dispatching = std::max(out.elapsed - first_dispatch, 0.0);
+    out.span = Span / 1e9;
+    out.parallelism = out.span > 0 ? out.work / out.span : 0;
+    out.speedup = out.elapsed > 0 ? out.work / out.elapsed : 0;
+    out.speedup_bound = std::min((double) _worker_count, out.parallelism);
+    out.efficiency = out.speedup_bound > 0 ? out.speedup / out.speedup_bound : 0;
+    out.overhead_per_task = out.task_count > 0 ?
+        std::max(_worker_count * dispatching - out.work - out.idle - out.lock_wait, 0.0) / out.task_count : 0;
+    return out;
+}
+
+
+
+// Counters are read one by one while workers update them: the ready count is approximate and clamped at zero.
+run_metrics task_metrics::_snapshot(size_t TasksLeft) const {
+    auto out = run_metrics();
+    auto finished = _finished.load();
+    out.elapsed = (finished != 0 ? finished : now()) / 1e9;
+    out.left = TasksLeft;
+    out.done = 0;
+    long long ready = (long long) _initial_ready + (long long) _submitted_ready.load(std::memory_order_relaxed);
+    for (int i = 0; i < _worker_count; ++i) {
+        auto & counters = _workers[i];
+        auto executed = counters.executed.load(std::memory_order_relaxed);
+        ready += (long long) counters.released.load(std::memory_order_relaxed) -
+                 (long long) counters.dispatched.load(std::memory_order_relaxed);
+        out.done += executed;
+        out.workers.push_back({ executed, counters.busy.load(std::memory_order_relaxed) / 1e9,
+                                counters.idle.load(std::memory_order_relaxed) / 1e9,
+                                counters.lock_wait.load(std::memory_order_relaxed) / 1e9 });
+    }
+    out.ready = (size_t) std::max(ready, 0ll);
+    out.throughput = out.elapsed > 0 ? out.done / out.elapsed : 0;
+    out.critical_path_done = 0;
+    return out;
+}
+
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace qp {
+
+// Counters of one worker: written only by the worker, read by anybody. Aligned to a cache line, so workers
+// don't invalidate each other's counters and polling doesn't slow them down.
+struct alignas(64) worker_counters {
+public:
+    std::atomic<std::uint64_t> executed;
+    // Tasks taken from ready queues and released by set_done.
+    std::atomic<std::uint64_t> dispatched;
+    std::atomic<std::uint64_t> released;
+    // Nanoseconds spent executing tasks, waiting for the condition variable and acquiring the scheduler's mutex.
+    std::atomic<std::uint64_t> busy;
+    std::atomic<std::uint64_t> idle;
+    std::atomic<std::uint64_t> lock_wait;
+
+public:
+    // Single writer: no read-modify-write is needed.
+    static void add(std::atomic<std::uint64_t> & Counter, std::uint64_t Value) {
+        Counter.store(Counter.load(std::memory_order_relaxed) + Value, std::memory_order_relaxed);
+    }
+
+};
+
+struct worker_metrics {
+public:
+    size_t executed;
+    // Seconds.
+    double busy;
+    double idle;
+    double lock_wait;
+
+};
+
+// A snapshot of a running (or finished) graph.
+struct run_metrics {
+public:
+    // Seconds since the start of the run.
+    double elapsed;
+    // Tasks in ready queues, done and not done yet (including running ones).
+    size_t ready;
+    size_t done;
+    size_t left;
+    // Tasks done per second since the start: the rate between two snapshots is the difference of done
+    // divided by the difference of elapsed.
+    double throughput;
+    // Share of the weight of the critical path (the heaviest chain of tasks) that is done, from 0 to 1.
+    double critical_path_done;
+    std::vector<worker_metrics> workers;
+
+};
+
+// Efficiency of a finished run against the bound set by its graph: the run can't be shorter than the span
+// (the longest chain of measured durations), so the speedup can't exceed min(threads, work / span).
+struct run_report {
+public:
+    int thread_count;
+    size_t task_count;
+    // Seconds: wall time of the run, the sum of task durations and the span.
+    double elapsed;
+    double work;
+    double span;
+    // work / span: the average number of tasks that can run at the same time.
+    double parallelism;
+    // work / elapsed against min(thread_count, parallelism), and their ratio.
+    double speedup;
+    double speedup_bound;
+    double efficiency;
+    // Seconds workers waited for the condition variable in total.
+    double idle;
+    // Seconds workers waited for the scheduler's mutex in total.
+    double lock_wait;
+    // Seconds per task that workers spent neither executing tasks, nor idle, nor waiting for the mutex
+    // from the first dispatch to the last task done: queues and bookkeeping.
+    double overhead_per_task;
+
+};
+
+// Live counters of a scheduler, enabled before a run. Workers update their own counters,
+// snapshots are taken by any thread while the graph runs.
+class task_metrics {
+private:
+    bool _is_enabled;
+    std::chrono::steady_clock::time_point _origin;
+    std::unique_ptr<worker_counters[]> _workers;
+    int _worker_count;
+
+    // Ready tasks at the start and ready tasks submitted by other threads than workers.
+    size_t _initial_ready;
+    std::atomic<std::uint64_t> _submitted_ready;
+
+    // Positions of the critical path and the weights done along it.
+    std::vector<size_t> _critical_path;
+    std::vector<int> _critical_weights;
+
+    // Measured durations by positions: each is written by the worker that executed the task.
+    std::vector<std::uint64_t> _durations;
+
+    // Time when the first task was dispatched and when the last task was done, zero until then.
+    std::atomic<std::uint64_t> _first_dispatch;
+    std::atomic<std::uint64_t> _finished;
+
+public:
+    task_metrics();
+
+    void enable();
+    void disable();
+    bool is_enabled() const;
+
+    // Resets the counters and starts the clock: called by a scheduler before its workers start.
+    void start(int WorkerCount, size_t TaskCount, size_t ReadyCount, std::vector<size_t> CriticalPath,
+               std::vector<int> CriticalWeights);
+
+    // Starts the clock of the overhead: called by workers on each dispatch, the first call counts.
+    void dispatched();
+
+    // Stops the clock of snapshots: the first call counts.
+    void finish();
+
+    // Nanoseconds since start().
+    std::uint64_t now() const;
+    worker_counters & worker(int Worker);
+
+    // Adds the time since Since to a counter of the calling worker and returns the current time.
+    std::uint64_t lap(std::atomic<std::uint64_t> & Counter, std::uint64_t Since) const;
+
+    // Thread-safe.
+    void add_submitted_ready(size_t Count);
+
+    // Tasks submitted during a run have positions beyond TaskCount: only the work counts their durations.
+    void set_duration(size_t Position, std::uint64_t Duration);
+    const std::vector<std::uint64_t> & durations() const;
+
+    // Call it after the run: Span is the longest chain of durations in nanoseconds.
+    run_report report(std::uint64_t Span) const;
+
+    // IsDone(Position) tells whether a task of the critical path is done. Thread-safe.
+    template<class IsDoneFunc>
+    run_metrics snapshot(size_t TasksLeft, const IsDoneFunc & IsDone) const {
+        auto out = _snapshot(TasksLeft);
+        long long total = 0;
+        long long done = 0;
+        for (size_t i = 0; i < _critical_path.size(); ++i) {
+            total += _critical_weights[i];
+            done += IsDone(_critical_path[i]) ? _critical_weights[i] : 0;
+        }
+        out.critical_path_done = total > 0 ? (double) done / total : (TasksLeft == 0 ? 1.0 : 0.0);
+        return out;
+    }
+
+private:
+    run_metrics _snapshot(size_t TasksLeft) const;
+
+};
+
+}
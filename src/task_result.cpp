@@ -0,0 +1,81 @@
+#include "task_result.hpp"
+
+namespace qp {
+
+task_result::task_result():
+    _value(nullptr),
+    _type(nullptr),
+    _destroy(nullptr),
+    _is_expected(false),
+    _consumers_left(0) {}
+
+
+
+task_result::~task_result() {
+    reset();
+}
+
+
+
+bool task_result::has_value() const {
+    return _value != nullptr;
+}
+
+
+
+void task_result::reset() {
+    if (_value) {
+        _destroy(_value);
+        _value = nullptr;
+        _type = nullptr;
+    }
+}
+
+
+
+void task_result::expect() {
+    _is_expected = true;
+}
+
+
+
+bool task_result::is_expected() const {
+    return _is_expected;
+}
+
+
+
+bool task_result::acquire() {
+    auto count = _consumers_left.load();
+    do {
+        if (count == _released) return false;
+    } while (!_consumers_left.compare_exchange_weak(count, count + 1));
+    return true;
+}
+
+
+
+// The last consumer marks the result as released before destroying it, so it can't be acquired meanwhile.
+void task_result::release() {
+    auto count = _consumers_left.load();
+    while (true) {
+        if (count == 1) {
+            if (_consumers_left.compare_exchange_weak(count, _released)) {
+                reset();
+                return;
+            }
+        }
+        else if (_consumers_left.compare_exchange_weak(count, count - 1)) {
+            return;
+        }
+    }
+}
+
+
+
+size_t task_result::consumers_left() const {
+    auto count = _consumers_left.load();
+    return count == _released ? 0 : count;
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace qp {
+
+// A value returned by a dataflow task, stored by a task_vector until the task's consumers (children) have finished.
+// Values up to inline_size bytes are stored inside the object, larger ones - on the heap.
+// Not movable: consumers keep pointers to their parents' results.
+class task_result {
+public:
+    static constexpr size_t inline_size = 48;
+
+private:
+    alignas(std::max_align_t) unsigned char _storage[inline_size];
+    void * _value;
+    const void * _type;
+    void (*_destroy)(void * Value);
+    bool _is_expected;
+
+    // Number of consumers that haven't finished yet, released when the last one finishes.
+    std::atomic_size_t _consumers_left;
+    static constexpr size_t _released = ~(size_t) 0;
+
+    template<class T>
+    static constexpr char _type_tag = 0;
+
+public:
+    task_result();
+    task_result(const task_result & TaskResult) = delete;
+    task_result & operator=(const task_result & TaskResult) = delete;
+    ~task_result();
+
+    template<class T, class ... Args>
+    T & emplace(Args && ... args) {
+        reset();
+        if constexpr (sizeof(T) <= inline_size && alignof(T) <= alignof(std::max_align_t)) {
+            _value = new (_storage) T(std::forward<Args>(args)...);
+            _destroy = [](void * Value) { static_cast<T *>(Value)->~T(); };
+        }
+        else {
+            _value = new T(std::forward<Args>(args)...);
+            _destroy = [](void * Value) { delete static_cast<T *>(Value); };
+        }
+        _type = &_type_tag<T>;
+        return *static_cast<T *>(_value);
+    }
+
+    // Returns nullptr if there is no value or it has a different type.
+    template<class T>
+    T * get() {
+        return _type == &_type_tag<T> ? static_cast<T *>(_value) : nullptr;
+    }
+
+    bool has_value() const;
+    void reset();
+
+    // Marks the result as one that is returned by a task, i.e. it can be consumed by the task's children.
+    void expect();
+    bool is_expected() const;
+
+    // Registers one more consumer. Returns false if the result was released already.
+    bool acquire();
+
+    // Called by a consumer that has finished: the last one releases the value.
+    void release();
+
+    // Number of consumers that haven't finished yet.
+    size_t consumers_left() const;
+
+};
+
+}
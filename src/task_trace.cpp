@@ -0,0 +1,136 @@
+#include "task_trace.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+namespace qp {
+
+task_trace::task_trace():
+    _is_enabled(false),
+    _capacity(0),
+    _origin(std::chrono::steady_clock::now()),
+    _rings(),
+    _ready() {}
+
+
+
+void task_trace::enable(size_t Capacity) {
+    _is_enabled = Capacity > 0;
+    _capacity = Capacity;
+}
+
+
+
+void task_trace::disable() {
+    _is_enabled = false;
+}
+
+
+
+bool task_trace::is_enabled() const {
+    return _is_enabled;
+}
+
+
+
+// Buffers are allocated here, so workers never allocate while recording.
+void task_trace::start(int WorkerCount, size_t TaskCount) {
+    _rings = std::vector<ring>(std::max(WorkerCount, 1));
+    for (auto & buffer : _rings) {
+        buffer.records.resize(_capacity);
+    }
+    _ready.assign(TaskCount, 0);
+    _origin = std::chrono::steady_clock::now();
+}
+
+
+
+std::uint64_t task_trace::now() const {
+    return (std::uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - _origin).count();
+}
+
+
+
+void task_trace::set_ready(size_t Position, std::uint64_t Time) {
+    if (Position < _ready.size()) {
+        _ready[Position] = Time;
+    }
+}
+
+
+
+std::uint64_t task_trace::ready(size_t Position, std::uint64_t Dispatch) const {
+    return Position < _ready.size() ? _ready[Position] : Dispatch;
+}
+
+
+
+void task_trace::record(int Worker, const trace_record & Record) {
+    auto & buffer = _rings[Worker];
+    buffer.records[buffer.next++ % _capacity] = Record;
+}
+
+
+
+std::vector<trace_record> task_trace::records() const {
+    auto out = std::vector<trace_record>();
+    for (auto & buffer : _rings) {
+        auto count = std::min(buffer.next, _capacity);
+        for (auto i = buffer.next - count; i < buffer.next; ++i) {
+            out.push_back(buffer.records[i % _capacity]);
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const trace_record & Left, const trace_record & Right) {
+        return Left.start < Right.start;
+    });
+    return out;
+}
+
+
+
+size_t task_trace::dropped() const {
+    size_t count = 0;
+    for (auto & buffer : _rings) {
+        count += buffer.next > _capacity ? buffer.next - _capacity : 0;
+    }
+    return count;
+}
+
+
+
+// Complete events ("ph":"X") with durations; thread names are metadata events.
+std::string task_trace::chrome_json() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for (size_t i = 0; i < _rings.size(); ++i) {
+        out << (i == 0 ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+            << ",\"args\":{\"name\":\"worker " << i << "\"}}";
+    }
+    auto us = [](std::uint64_t Time) { return Time / 1000.0; };
+    for (auto & rec : records()) {
+        out << ",\n{\"name\":\"dispatch\",\"cat\":\"scheduler\",\"ph\":\"X\",\"pid\":1,\"tid\":" << rec.worker
+            << ",\"ts\":" << us(rec.dispatch) << ",\"dur\":" << us(rec.start - rec.dispatch)
+            << ",\"args\":{\"id\":" << rec.id << "}}";
+        out << ",\n{\"name\":\"task " << rec.id << "\",\"cat\":\"task\",\"ph\":\"X\",\"pid\":1,\"tid\":" << rec.worker
+            << ",\"ts\":" << us(rec.start) << ",\"dur\":" << us(rec.end - rec.start)
+            << ",\"args\":{\"id\":" << rec.id << ",\"position\":" << rec.position
+            << ",\"ready\":" << us(rec.ready) << ",\"dispatch\":" << us(rec.dispatch)
+            << ",\"queued\":" << us(rec.dispatch - rec.ready) << "}}";
+    }
+    out << "\n]}\n";
+    return out.str();
+}
+
+
+
+bool task_trace::write_chrome_json(const std::string & Path) const {
+    std::ofstream fout(Path, std::ios::trunc);
+    if (!fout) return false;
+    fout << chrome_json();
+    return (bool) fout.flush();
+}
+
+}
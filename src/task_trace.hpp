@@ -0,0 +1,82 @@
+#pragma once
+#include "task.hpp"
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+// Tracing is compiled in unless QP_TRACE is defined as 0: schedulers check it together with is_enabled(),
+// so the recording code is removed by the compiler.
+#ifndef QP_TRACE
+#define QP_TRACE 1
+#endif
+
+namespace qp {
+
+// Timestamps of a task in nanoseconds since the start of a run.
+struct trace_record {
+public:
+    task_id id;
+    size_t position;
+    int worker;
+    // Parents are done (or the run has started for tasks without parents).
+    std::uint64_t ready;
+    // Taken from a ready queue by the worker.
+    std::uint64_t dispatch;
+    std::uint64_t start;
+    std::uint64_t end;
+
+};
+
+// Records of executed tasks in per-worker ring buffers: a worker writes only its own buffer, so recording takes
+// no locks. The oldest records of a worker are overwritten when its buffer is full.
+// Not thread-safe, except record() and set_ready() that are called by workers during a run.
+class task_trace {
+private:
+    struct alignas(64) ring {
+        std::vector<trace_record> records;
+        size_t next = 0;
+    };
+
+    bool _is_enabled;
+    size_t _capacity;
+    std::chrono::steady_clock::time_point _origin;
+    std::vector<ring> _rings;
+
+    // Ready timestamps by positions, zero for tasks ready at the start. Written by the worker that releases a task
+    // before it's pushed to a ready queue, read by the worker that executes it.
+    std::vector<std::uint64_t> _ready;
+
+public:
+    task_trace();
+
+    // Capacity is the number of records kept per worker.
+    void enable(size_t Capacity = 65536);
+    void disable();
+    bool is_enabled() const;
+
+    // Clears the records and starts the clock: called by a scheduler before its workers start.
+    void start(int WorkerCount, size_t TaskCount);
+
+    // Nanoseconds since start().
+    std::uint64_t now() const;
+
+    // Tasks submitted during a run have positions beyond TaskCount: their ready time is the dispatch time.
+    void set_ready(size_t Position, std::uint64_t Time);
+    std::uint64_t ready(size_t Position, std::uint64_t Dispatch) const;
+    void record(int Worker, const trace_record & Record);
+
+    // Kept records of all workers ordered by start.
+    std::vector<trace_record> records() const;
+
+    // Number of records overwritten because buffers were full.
+    size_t dropped() const;
+
+    // Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev): a slice per task on its worker's track
+    // and a slice per dispatch (from leaving a ready queue to the start). Times are in microseconds.
+    std::string chrome_json() const;
+    bool write_chrome_json(const std::string & Path) const;
+
+};
+
+}
@@ -1,80 +1,688 @@
 #include "task_vector.hpp"
 #include "container.hpp"
+#include "radix_sort.hpp"
+#include "parallel_for.hpp"
 #include <algorithm>
+#include <mutex>
+#include <unordered_set>
 #include <random>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
 
 namespace qp {
 
+struct order_header {
+    char magic[8];
+    std::uint64_t version;
+    std::uint64_t task_count;
+    std::uint64_t edge_count;
+    std::uint64_t edge_hash;
+};
+
+static const char _order_magic[8] = { 'q', 'p', 'o', 'r', 'd', 'e', 'r', '\0' };
+static const std::uint64_t _order_version = 1;
+
+// FNV-1a over 8-byte words of a task's ID and its parents' IDs.
+static std::uint64_t _hash_edges(const task & Task, std::uint64_t Hash) {
+    auto mix = [&Hash](std::uint64_t Value) {
+        Hash = (Hash ^ Value) * 0x100000001b3ull;
+    };
+    mix(Task.id());
+    mix(Task.parents().size());
+    for (auto par_id : Task.parents()) {
+        mix(par_id);
+    }
+    return Hash;
+}
+
+static const std::uint64_t _hash_seed = 0xcbf29ce484222325ull;
+
+// Rows read from a snapshot mustn't point outside of the graph.
+static bool _valid_rows(const std::vector<size_t> & Offset, const std::vector<size_t> & Index, size_t Count) {
+    if (Offset.front() != 0 || Offset.back() != Index.size()) return false;
+    for (size_t i = 0; i < Count; ++i) {
+        if (Offset[i] > Offset[i + 1]) return false;
+    }
+    return std::all_of(Index.begin(), Index.end(), [Count](size_t Position) { return Position < Count; });
+}
+
+
+
+// Upward rank of a task with the given weight and the largest rank of its children. It isn't less than
+// the children's ranks even for a negative weight, so ordering by ranks keeps parents before their children.
+static long long _upward_rank(int Weight, bool HasChildren, long long Longest) {
+    return HasChildren ? std::max(Weight + Longest, Longest) : Weight;
+}
+
+
+
+// Depth-first search placing Start right after all its ancestors that aren't placed yet: Place(i) is called
+// for each of them in order. Parents(i) returns a position_range of parents' indices, parents for which
+// Include(i) is false are treated as placed.
+// State of each index: 0 - not visited, 1 - on the stack, 2 - placed. Returns false if relationships are cyclic
+// and fills Cycle with the indices of a cycle: each one is a parent of the next one, the last one is a parent
+// of the first one.
+template<class ParentsFunc, class IncludeFunc, class PlaceFunc>
+static bool _search_ancestors(size_t Start, const ParentsFunc & Parents, const IncludeFunc & Include,
+                              const PlaceFunc & Place, std::vector<unsigned char> & State,
+                              std::vector<std::pair<size_t, const size_t *>> & Stack, std::vector<size_t> & Cycle) {
+    State[Start] = 1;
+    Stack.emplace_back(Start, Parents(Start).begin());
+    while (!Stack.empty()) {
+        auto & top = Stack.back();
+        auto end = Parents(top.first).end();
+        // Skip parents that are placed already.
+        while (top.second != end && (!Include(*top.second) || State[*top.second] == 2)) {
+            ++top.second;
+        }
+        // All parents are placed - place the task.
+        if (top.second == end) {
+            State[top.first] = 2;
+            Place(top.first);
+            Stack.pop_back();
+            continue;
+        }
+        // Go to the next parent. A parent on the stack means a cycle: each task on the stack is a child
+        // of the next one, so the cycle goes from the top of the stack down to the parent.
+        auto par_pos = *top.second++;
+        if (State[par_pos] == 1) {
+            for (auto it = Stack.rbegin(); it->first != par_pos; ++it) {
+                Cycle.push_back(it->first);
+            }
+            Cycle.push_back(par_pos);
+            Stack.clear();
+            return false;
+        }
+        State[par_pos] = 1;
+        Stack.emplace_back(par_pos, Parents(par_pos).begin());
+    }
+    return true;
+}
+
+
+
+// Places each of Count tasks right after all its ancestors that aren't placed yet, in order of Visit
+// (or of indices if Visit is null). Returns false if relationships are cyclic, see _search_ancestors.
+template<class ParentsFunc>
+static bool _place_after_ancestors(size_t Count, const size_t * Visit, const ParentsFunc & Parents,
+                                   std::vector<size_t> & Order, std::vector<size_t> & Cycle) {
+    auto state = std::vector<unsigned char>(Count, 0);
+    auto stack = std::vector<std::pair<size_t, const size_t *>>();
+    auto include = [](size_t) { return true; };
+    auto place = [&Order](size_t Index) { Order.push_back(Index); };
+    Order.clear();
+    Order.reserve(Count);
+    Cycle.clear();
+
+    for (size_t v = 0; v < Count; ++v) {
+        auto i = Visit ? Visit[v] : v;
+        if (state[i] == 0 && !_search_ancestors(i, Parents, include, place, state, stack, Cycle)) return false;
+    }
+    return true;
+}
+
+
+
+// Calls Visit(i) for each task after it was called for all the task's children: tasks are visited level by level
+// starting from the ones without children, the tasks of a level by ThreadCount threads in parallel.
+// Returns false if relationships are cyclic: tasks of a cycle and their ancestors are never visited.
+template<class VisitFunc>
+static bool _visit_from_sinks(const task_graph & Graph, int ThreadCount, const VisitFunc & Visit) {
+    auto count = Graph.size();
+    auto children_left = std::vector<std::atomic_size_t>(count);
+    auto level = std::vector<size_t>();
+    auto next = std::vector<size_t>();
+    std::mutex level_mutex;
+    parallel_for(count, ThreadCount, [&](size_t First, size_t Last) {
+        auto sinks = std::vector<size_t>();
+        for (auto i = First; i < Last; ++i) {
+            auto left = Graph.children(i).size();
+            children_left[i].store(left, std::memory_order_relaxed);
+            if (left == 0) sinks.push_back(i);
+        }
+        std::lock_guard<std::mutex> lock(level_mutex);
+        level.insert(level.end(), sinks.begin(), sinks.end());
+    });
+
+    // A parent joins the next level when its last child is visited. Levels are separated by joining threads.
+    size_t visited = 0;
+    while (!level.empty()) {
+        visited += level.size();
+        next.clear();
+        parallel_for(level.size(), ThreadCount, [&](size_t First, size_t Last) {
+            auto ready = std::vector<size_t>();
+            for (auto k = First; k < Last; ++k) {
+                Visit(level[k]);
+                for (auto par_pos : Graph.parents(level[k])) {
+                    if (children_left[par_pos].fetch_sub(1, std::memory_order_relaxed) == 1) {
+                        ready.push_back(par_pos);
+                    }
+                }
+            }
+            std::lock_guard<std::mutex> lock(level_mutex);
+            next.insert(next.end(), ready.begin(), ready.end());
+        }, 1024);
+        level.swap(next);
+    }
+    return visited == count;
+}
+
+
+
+// The same order as _place_after_ancestors() in order of positions, by ThreadCount threads. The search started
+// at position i places the ancestors of i that no search started at a smaller position has placed: the tasks whose
+// smallest descendant (their owner) is i. Owners are found level by level from the tasks without children, then
+// the searches of all owners run in parallel, each one skipping the tasks of other owners, and write their segments
+// to Order after the segments of smaller owners. Wide graphs scale with threads, including ones hanging off
+// a common root; a task visited early that is a descendant of most of the graph (e.g. a sink of the smallest
+// position) owns most of it and its search is done by one thread. A cyclic graph is searched again serially,
+// so the reported cycle is the one the serial search finds.
+static bool _place_after_ancestors(const task_graph & Graph, int ThreadCount, std::vector<size_t> & Order,
+                                   std::vector<size_t> & Cycle) {
+    auto count = Graph.size();
+    auto parents = [&Graph](size_t Position) { return Graph.parents(Position); };
+    auto owner = std::vector<size_t>(count);
+    auto segment_size = std::vector<std::atomic_size_t>(count);
+    parallel_for(count, ThreadCount, [&](size_t First, size_t Last) {
+        for (auto i = First; i < Last; ++i) {
+            segment_size[i].store(0, std::memory_order_relaxed);
+        }
+    });
+    auto is_acyclic = _visit_from_sinks(Graph, ThreadCount, [&](size_t Position) {
+        auto smallest = Position;
+        for (auto child : Graph.children(Position)) {
+            smallest = std::min(smallest, owner[child]);
+        }
+        owner[Position] = smallest;
+        segment_size[smallest].fetch_add(1, std::memory_order_relaxed);
+    });
+    if (!is_acyclic) return _place_after_ancestors(count, nullptr, parents, Order, Cycle);
+
+    auto first = std::vector<size_t>(count + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        first[i + 1] = first[i] + segment_size[i].load(std::memory_order_relaxed);
+    }
+    Order.resize(count);
+    Cycle.clear();
+
+    // Each task is placed only by the search of its owner: states of different searches don't overlap.
+    const size_t block = 1024;
+    auto state = std::vector<unsigned char>(count, 0);
+    std::atomic_size_t next_block(0);
+    parallel_for((size_t) ThreadCount, ThreadCount, [&](size_t, size_t) {
+        auto stack = std::vector<std::pair<size_t, const size_t *>>();
+        auto cycle = std::vector<size_t>();
+        for (auto b = next_block++; b * block < count; b = next_block++) {
+            for (auto i = b * block; i < std::min(count, (b + 1) * block); ++i) {
+                if (owner[i] != i) continue;
+                auto out = first[i];
+                auto include = [&owner, i](size_t Position) { return owner[Position] == i; };
+                auto place = [&Order, &out](size_t Position) { Order[out++] = Position; };
+                _search_ancestors(i, parents, include, place, state, stack, cycle);
+            }
+        }
+    }, 1);
+    return true;
+}
+
+
+
 task_vector::task_vector():
+    _current_index(0),
+    _arena(),
     _tasks(),
+    _is_sorted(false),
+    _thread_count(1),
+    _sort_error(),
+    _cycle(),
     _is_done(),
-    _current_index(0) {}
+    _is_cancelled(),
+    _positions(),
+    _graph(),
+    _parents_left(),
+    _file(),
+    _kinds(),
+    _nodes(),
+    _node_positions(),
+    _results(),
+    _ready(),
+    _has_submitted(false),
+    _submitted(),
+    _submitted_children(),
+    _released() {}
 
 
 
 task_vector::task_vector(task_vector && TaskVector):
+    _current_index(TaskVector._current_index),
+    _arena(std::move(TaskVector._arena)),
     _tasks(std::move(TaskVector._tasks)),
+    _is_sorted(TaskVector._is_sorted),
+    _thread_count(TaskVector._thread_count),
+    _sort_error(std::move(TaskVector._sort_error)),
+    _cycle(std::move(TaskVector._cycle)),
     _is_done(std::move(TaskVector._is_done)),
-    _current_index(TaskVector._current_index) {}
+    _is_cancelled(std::move(TaskVector._is_cancelled)),
+    _positions(std::move(TaskVector._positions)),
+    _graph(std::move(TaskVector._graph)),
+    _parents_left(std::move(TaskVector._parents_left)),
+    _file(std::move(TaskVector._file)),
+    _kinds(std::move(TaskVector._kinds)),
+    _nodes(std::move(TaskVector._nodes)),
+    _node_positions(std::move(TaskVector._node_positions)),
+    _results(std::move(TaskVector._results)),
+    _ready(std::move(TaskVector._ready)),
+    _has_submitted(TaskVector._has_submitted.load()),
+    _submitted(std::move(TaskVector._submitted)),
+    _submitted_children(std::move(TaskVector._submitted_children)),
+    _released() {}
 
 
 
 task_vector & task_vector::operator=(task_vector && TaskVector) {
+    _current_index = TaskVector._current_index;
     _tasks = std::move(TaskVector._tasks);
+    _is_sorted = TaskVector._is_sorted;
+    _thread_count = TaskVector._thread_count;
+    _sort_error = std::move(TaskVector._sort_error);
+    _cycle = std::move(TaskVector._cycle);
     _is_done = std::move(TaskVector._is_done);
+    _is_cancelled = std::move(TaskVector._is_cancelled);
+    _positions = std::move(TaskVector._positions);
+    _graph = std::move(TaskVector._graph);
+    _parents_left = std::move(TaskVector._parents_left);
+    _file = std::move(TaskVector._file);
+    _kinds = std::move(TaskVector._kinds);
+    _nodes = std::move(TaskVector._nodes);
+    _node_positions = std::move(TaskVector._node_positions);
+    _results = std::move(TaskVector._results);
+    _ready = std::move(TaskVector._ready);
+    _has_submitted = TaskVector._has_submitted.load();
+    _submitted = std::move(TaskVector._submitted);
+    _submitted_children = std::move(TaskVector._submitted_children);
+    // Previous tasks are destroyed by now, their memory can be freed.
+    _arena = std::move(TaskVector._arena);
     return *this;
 }
 
 
 
 void task_vector::emplace(task_ptr Task) {
-    _is_done.emplace(Task->id(), false);
+    _is_sorted = false;
     _tasks.emplace_back(std::move(Task));
 }
 
 
 
+task & task_vector::emplace(int Weight) {
+    return _emplace_in_arena(Weight, nullptr, 0);
+}
+
+
+
+task & task_vector::emplace(int Weight, task_id ParentId) {
+    return _emplace_in_arena(Weight, &ParentId, 1);
+}
+
+
+
+task & task_vector::emplace(int Weight, const std::vector<task_id> & ParentId) {
+    return _emplace_in_arena(Weight, ParentId.data(), ParentId.size());
+}
+
+
+
+task & task_vector::emplace(int Weight, id_range ParentId) {
+    return _emplace_in_arena(Weight, ParentId.begin(), ParentId.size());
+}
+
+
+
+// Each thread fills its own block of slots, so tasks are placed in order of i.
+void task_vector::generate(size_t Count, const std::function<task_ptr(size_t)> & Make, int ThreadCount) {
+    auto first = _tasks.size();
+    _tasks.resize(first + Count);
+    try {
+        parallel_for(Count, ThreadCount, [&](size_t First, size_t Last) {
+            for (auto i = First; i < Last; ++i) {
+                _tasks[first + i] = Make(i);
+            }
+        }, 1024);
+    }
+    catch (...) {
+        _tasks.resize(first);
+        throw;
+    }
+    _is_sorted = false;
+}
+
+
+
 task_ptr & task_vector::operator[](size_t i) {
-    return _tasks[i];
+    if (i < _tasks.size()) {
+        return _tasks[i];
+    }
+    return _submitted.at(i - _sorted_size()).task;
 }
 
 
 
 void task_vector::clear() {
+    _current_index = 0;
     _tasks.clear();
+    _is_sorted = false;
+    _sort_error.clear();
+    _cycle.clear();
     _is_done.clear();
+    _is_cancelled.clear();
+    _positions.clear();
+    _graph.clear();
+    _parents_left.clear();
+    _file.close();
+    _kinds.clear();
+    _nodes.clear();
+    _node_positions.clear();
+    _results.clear();
+    _ready = decltype(_ready)();
+    _has_submitted = false;
+    _submitted.clear();
+    _submitted_children.clear();
+    _arena.clear();
 }
 
 
 
 void task_vector::reserve(size_t Size) {
     _tasks.reserve(Size);
-    _is_done.reserve(Size);
 }
 
 
 
 size_t task_vector::size() const {
-    return _tasks.size();
+    return _sorted_size() + _submitted.size();
 }
 
 
 
-bool task_vector::sort() {
-    // Sort ascending by tasks' weights.
-    _sort_by_weights();
+bool task_vector::sort(sort_algorithm Algorithm, int ThreadCount) {
+    _merge_submitted();
+    _thread_count = std::max(ThreadCount, 1);
+    _sort_error.clear();
+    _cycle.clear();
+    if (_file.is_open()) {
+        _is_sorted = _sort_mapped(Algorithm);
+    }
+    else if (Algorithm == sort_algorithm::chained) {
+        _is_sorted = _sort_chained();
+    }
+    else if (Algorithm == sort_algorithm::critical_path) {
+        _is_sorted = _sort_critical_path();
+    }
+    else {
+        _is_sorted = _sort_linear();
+    }
+    return _is_sorted;
+}
+
+
+
+// Submitted tasks aren't sorted yet: they are merged by the next sort().
+bool task_vector::is_sorted() const {
+    return _is_sorted && !_has_submitted;
+}
+
+
+
+const std::string & task_vector::sort_error() const {
+    return _sort_error;
+}
+
+
+
+const std::vector<task_id> & task_vector::cycle() const {
+    return _cycle;
+}
+
 
-    // Prepare temporary containers: pass sorted vector of tasks.
-    auto temp = container(_tasks);
-    auto ordered = std::vector<task_ptr> ();
-    ordered.reserve(_tasks.size());
 
-    // Check all parents are in a test set.
+// Snapshot: the header, tasks' IDs by positions and the compiled task_graph's rows in native byte order.
+bool task_vector::save_order(const std::string & Path) const {
+    if (!is_sorted() || _file.is_open()) return false;
+    auto hash = _hash_seed;
     for (auto & tsk : _tasks) {
-        for (auto & par_id : tsk->parents()) {
-            if ( temp.positions.find(par_id) == temp.positions.end() ) return false;
+        hash = _hash_edges(*tsk, hash);
+    }
+    order_header head = {};
+    std::memcpy(head.magic, _order_magic, sizeof(_order_magic));
+    head.version = _order_version;
+    head.task_count = _tasks.size();
+    head.edge_count = _graph.parent_index.size();
+    head.edge_hash = hash;
+
+    auto ids = std::vector<task_id>(_tasks.size());
+    for (size_t i = 0; i < _tasks.size(); ++i) {
+        ids[i] = _tasks[i]->id();
+    }
+    std::ofstream fout(Path, std::ios::binary | std::ios::trunc);
+    if (!fout) return false;
+    auto write = [&fout](const void * Data, size_t Size) {
+        fout.write((const char *) Data, Size);
+    };
+    write(&head, sizeof(head));
+    write(ids.data(), ids.size() * sizeof(task_id));
+    write(_graph.parent_offset.data(), _graph.parent_offset.size() * sizeof(size_t));
+    write(_graph.parent_index.data(), _graph.parent_index.size() * sizeof(size_t));
+    write(_graph.child_offset.data(), _graph.child_offset.size() * sizeof(size_t));
+    write(_graph.child_index.data(), _graph.child_index.size() * sizeof(size_t));
+    return (bool) fout.flush();
+}
+
+
+
+// Tasks are checked before anything is changed: O(n+v) without resolving parents' IDs.
+bool task_vector::load_order(const std::string & Path) {
+    _merge_submitted();
+    if (_file.is_open()) return false;
+    std::ifstream fin(Path, std::ios::binary);
+    order_header head;
+    if (!fin.read((char *) &head, sizeof(head)) || std::memcmp(head.magic, _order_magic, sizeof(_order_magic)) != 0 ||
+        head.version != _order_version || head.task_count != _tasks.size()) {
+        return false;
+    }
+    auto count = _tasks.size();
+    auto ids = std::vector<task_id>(count);
+    if (!fin.read((char *) ids.data(), count * sizeof(task_id))) return false;
+
+    // Current positions of the tasks by their positions in the snapshot.
+    auto positions = id_index();
+    if (!positions.build(ids, _thread_count)) return false;
+    auto source = std::vector<size_t>(count, count);
+    for (size_t i = 0; i < count; ++i) {
+        if (_tasks[i] == nullptr) return false;
+        auto pos = positions.find(_tasks[i]->id());
+        if (pos == id_index::npos || source[pos] != count) return false;
+        source[pos] = i;
+    }
+    // The edge count is checked before the rows are allocated: a foreign snapshot can't make them arbitrarily large.
+    auto hash = _hash_seed;
+    size_t edge_count = 0;
+    for (auto pos : source) {
+        hash = _hash_edges(*_tasks[pos], hash);
+        edge_count += _tasks[pos]->parents().size();
+    }
+    if (hash != head.edge_hash || edge_count != head.edge_count) return false;
+
+    // Parents' rows must hold the tasks' parents (in any order), children's rows must be built from them:
+    // dispatching counts parents by the former and releases children by the latter.
+    auto graph = task_graph();
+    auto child_offset = std::vector<size_t>(count + 1);
+    auto child_index = std::vector<size_t>(head.edge_count);
+    graph.parent_offset.resize(count + 1);
+    graph.parent_index.resize(head.edge_count);
+    for (auto rows : { &graph.parent_offset, &graph.parent_index, &child_offset, &child_index }) {
+        if (!fin.read((char *) rows->data(), rows->size() * sizeof(size_t))) return false;
+    }
+    if (!_valid_rows(graph.parent_offset, graph.parent_index, count)) return false;
+    std::atomic_bool is_matching(true);
+    parallel_for(count, _thread_count, [&](size_t First, size_t Last) {
+        // Stored parents are counted, the tasks' parents are subtracted: O(v) for any order of a row.
+        auto stored = std::vector<int>(count, 0);
+        for (auto i = First; i < Last && is_matching; ++i) {
+            auto par_ids = _tasks[source[i]]->parents();
+            auto row = graph.parents(i);
+            if (par_ids.size() != row.size()) {
+                is_matching = false;
+                break;
+            }
+            for (auto par_pos : row) {
+                ++stored[par_pos];
+            }
+            for (auto par_id : par_ids) {
+                auto par_pos = positions.find(par_id);
+                if (par_pos == id_index::npos || stored[par_pos] == 0) {
+                    is_matching = false;
+                    break;
+                }
+                --stored[par_pos];
+            }
+            for (auto par_pos : row) {
+                stored[par_pos] = 0;
+            }
         }
+    });
+    if (!is_matching) return false;
+    graph.build_children(_thread_count);
+    if (graph.child_offset != child_offset || graph.child_index != child_index) return false;
+
+    auto ordered = std::vector<task_ptr>();
+    ordered.reserve(count);
+    for (auto pos : source) {
+        ordered.emplace_back(std::move(_tasks[pos]));
     }
+    _tasks.swap(ordered);
+    _positions = std::move(positions);
+    _graph = std::move(graph);
+    _build_dependencies();
+    _sort_error.clear();
+    _cycle.clear();
+    _is_sorted = true;
+    return true;
+}
+
+
+
+// Parents are released together with the task by task_deleter, a task without parents doesn't allocate them.
+task & task_vector::_emplace_in_arena(int Weight, const task_id * ParentId, size_t ParentCount) {
+    task_id * parents = nullptr;
+    if (ParentCount > 0) {
+        parents = (task_id *) _arena.allocate(ParentCount * sizeof(task_id), alignof(task_id));
+        std::copy(ParentId, ParentId + ParentCount, parents);
+    }
+    auto tsk = _arena.create<task>(Weight, id_range{ parents, parents + ParentCount });
+    _tasks.emplace_back(tsk, task_deleter(false));
+    _is_sorted = false;
+    return *tsk;
+}
+
+
+
+// Number of tasks placed by sort(): submitted tasks' positions go after them.
+size_t task_vector::_sorted_size() const {
+    return _file.is_open() ? _file.size() : _tasks.size();
+}
+
+
+
+// Mapped tasks are found in the file: they have positions after sort().
+bool task_vector::_find_position(task_id Id, size_t & OutPosition) const {
+    auto pos = _positions.find(Id);
+    if (pos != id_index::npos) {
+        OutPosition = pos;
+        return true;
+    }
+    if (_node_positions.empty()) return false;
+    auto node = _file.find(Id);
+    if (node == graph_file::npos) return false;
+    OutPosition = _node_positions[node];
+    return true;
+}
+
+
+
+bool task_vector::_fail(std::string Error) {
+    _sort_error = std::move(Error);
+    return false;
+}
+
+
+
+// Finds what task_graph::build() failed on: it's called only when a sort fails, so it doesn't need to be fast.
+bool task_vector::_fail_build() {
+    auto ids = std::unordered_set<task_id>();
+    ids.reserve(_tasks.size());
+    for (auto & tsk : _tasks) {
+        if (!ids.insert(tsk->id()).second) {
+            return _fail("Task ID " + std::to_string(tsk->id()) + " repeats.");
+        }
+    }
+    for (auto & tsk : _tasks) {
+        for (auto par_id : tsk->parents()) {
+            if (ids.count(par_id) == 0) {
+                return _fail("Parent " + std::to_string(par_id) + " of task " + std::to_string(tsk->id()) +
+                             " is not present.");
+            }
+        }
+    }
+    return _fail("Not all parents are present.");
+}
+
+
+
+// Long cycles are cut in the message, cycle() returns all of their IDs.
+bool task_vector::_fail_cycle() {
+    const size_t max_shown = 16;
+    auto error = "Relationships are cyclic (" + std::to_string(_cycle.size()) + " tasks): ";
+    for (size_t i = 0; i < _cycle.size() && i < max_shown; ++i) {
+        error += std::to_string(_cycle[i]) + " -> ";
+    }
+    error += _cycle.size() > max_shown ? "... -> " + std::to_string(_cycle.front()) : std::to_string(_cycle.front());
+    return _fail(error + ".");
+}
+
+
+
+// Places the tasks of the compiled graph after their ancestors in order of positions, with several threads
+// by the parallel version of _place_after_ancestors. Reports a cycle if there is one.
+bool task_vector::_place_graph(std::vector<size_t> & Order) {
+    auto cycle = std::vector<size_t>();
+    auto parents = [this](size_t Position) { return _graph.parents(Position); };
+    auto is_placed = _thread_count > 1 ? _place_after_ancestors(_graph, _thread_count, Order, cycle) :
+                                         _place_after_ancestors(_tasks.size(), nullptr, parents, Order, cycle);
+    if (is_placed) return true;
+    for (auto pos : cycle) {
+        _cycle.push_back(_tasks[pos]->id());
+    }
+    return _fail_cycle();
+}
+
+
+
+bool task_vector::_sort_chained() {
+    // Sort ascending by tasks' weights.
+    _sort_by_weights();
+
+    // Compile relationships once. Returns false if not all parents are in a test set.
+    if (!_graph.build(_tasks, _positions, _thread_count)) return _fail_build();
+
+    // Chaining doesn't finish on cycles: check them first in O(n+v).
+    auto placed = std::vector<size_t>();
+    if (!_place_graph(placed)) return false;
+
+    // Prepare temporary containers.
+    auto temp = container(_tasks.size());
+    auto order = std::vector<size_t> ();
+    order.reserve(_tasks.size());
 
     // Process all tasks.
     for (size_t i = 0; i < _tasks.size(); ++i) {
@@ -88,16 +696,16 @@ bool task_vector::sort() {
                 temp.prepare_to_iteration();
                 // Process all tasks in current iteration.
                 for (auto it = temp.current.begin(); it != temp.current.end(); ++it) {
-                    // Get parents' IDs of the task.
-                    auto parents = _tasks[(*it)]->parents();
+                    // Get parents' positions of the task.
+                    auto parents = _graph.parents(*it);
                     // If task has no parents - move the task to the next iteration.
-                    if (parents.size() == 0) {
+                    if (parents.empty()) {
                         temp.move_current_to_next(*it);
                     }
                     // If task has parents - add its parents to the next iteration.
                     else {
-                        for (auto par_id : parents) {
-                            temp.add_parent_to_next(par_id);
+                        for (auto par_pos : parents) {
+                            temp.add_parent_to_next(par_pos);
                         }
                         temp.next_are_parentless = false;
                     }
@@ -112,17 +720,20 @@ bool task_vector::sort() {
                 // Otherwise continue chaining the tasks - push next to current.
                 temp.set_next_as_current();
             }
-            // Replace queued tasks to final ordered vector.
+            // Replace queued tasks to final order.
             for (auto pos : temp.temp_queue) {
-                ordered.emplace_back(std::move(_tasks.at(pos)));
+                order.push_back(pos);
             }
             // Clear the queue for the next iteration.
             temp.temp_queue.clear();
         }
     }
 
-    // Finally: back to input vector.
-    _tasks.swap(ordered);
+    // Finally: move tasks and their relationships to the final order.
+    _apply_order(order);
+
+    // Prepare the ready queue for dispatching.
+    _build_dependencies();
 
     return true;
 }
@@ -130,27 +741,304 @@ bool task_vector::sort() {
 
 
 // Returns false if the last task was returned.
-bool task_vector::pop_next(task_ptr & OutTask) {
-    for (size_t i = _current_index; i < _tasks.size(); ++i) {
-        if (_parents_ready(i)) {
-            // Move the task to be executed to the beginning of the queue.
-            _tasks[i].swap(_tasks[_current_index]);
-            OutTask = std::move(_tasks[_current_index]);
-            ++_current_index;
-            // If thread got the last task in the queue - say finish to other tasks.
-            if (_current_index == _tasks.size()) {
-                return false;
-            }
-            break;
-        } 
+bool task_vector::pop_next(task_ptr & OutTask, size_t & OutPosition) {
+    if (_current_index == size()) return false;
+    // No task is ready - wait for set_done.
+    if (_ready.empty()) return true;
+
+    // Take the first ready task in sorted order.
+    _start_dispatch();
+    OutPosition = _ready.top();
+    _ready.pop();
+    OutTask = take(OutPosition);
+    ++_current_index;
+
+    // If thread got the last task in the queue - say finish to other tasks.
+    return _current_index != size();
+}
+
+
+
+void task_vector::set_done(size_t Position) {
+    // Release children: the ones without unfinished parents become ready.
+    _released.clear();
+    set_done(Position, _released);
+    for (auto child : _released) {
+        _ready.push(child);
+    }
+}
+
+
+
+const std::vector<size_t> & task_vector::released() const {
+    return _released;
+}
+
+
+
+bool task_vector::is_done(size_t Position) const {
+    if (Position < _sorted_size()) {
+        return _is_done[Position / 64].flags[Position % 64];
+    }
+    std::lock_guard<std::mutex> lock(_submit_mutex);
+    return _submitted[Position - _sorted_size()].is_done;
+}
+
+
+
+size_t task_vector::ready_count() const {
+    return _ready.size();
+}
+
+
+
+int task_vector::weight(size_t Position) const {
+    return _file.is_open() ? _file.weight(_nodes[Position]) : _tasks[Position]->weight();
+}
+
+
+
+// Upward ranks are computed from the end as in the critical path sort, then the chain goes from the task
+// with the largest rank through the children with the largest ranks.
+template<class CostFunc>
+std::vector<size_t> task_vector::_heaviest_chain(const CostFunc & Cost) const {
+    auto count = _sorted_size();
+    auto ranks = std::vector<long long>(count);
+    auto heaviest_child = std::vector<size_t>(count, count);
+    auto visit = [&ranks, &heaviest_child, count](size_t Position, size_t Child) {
+        if (heaviest_child[Position] == count || ranks[Child] > ranks[heaviest_child[Position]]) {
+            heaviest_child[Position] = Child;
+        }
+    };
+    for (size_t i = count; i-- > 0;) {
+        if (_file.is_open()) {
+            for (auto child : _file.children(_nodes[i])) {
+                visit(i, _node_positions[child]);
+            }
+        }
+        else {
+            for (auto child : _graph.children(i)) {
+                visit(i, child);
+            }
+        }
+        ranks[i] = Cost(i) + (heaviest_child[i] == count ? 0 : ranks[heaviest_child[i]]);
+    }
+
+    auto path = std::vector<size_t>();
+    if (count == 0) return path;
+    for (auto pos = (size_t) (std::max_element(ranks.begin(), ranks.end()) - ranks.begin()); pos != count;
+         pos = heaviest_child[pos]) {
+        path.push_back(pos);
+    }
+    return path;
+}
+
+
+
+std::vector<size_t> task_vector::critical_path() const {
+    return _heaviest_chain([this](size_t Position) { return (long long) weight(Position); });
+}
+
+
+
+std::vector<size_t> task_vector::critical_path(const std::vector<std::uint64_t> & Costs) const {
+    return _heaviest_chain([&Costs](size_t Position) {
+        return Position < Costs.size() ? (long long) Costs[Position] : 0ll;
+    });
+}
+
+
+
+// Moves all ready tasks' positions in sorted order to OutPositions.
+void task_vector::pop_ready(std::vector<size_t> & OutPositions) {
+    _start_dispatch();
+    while (!_ready.empty()) {
+        OutPositions.push_back(_ready.top());
+        _ready.pop();
+        ++_current_index;
+    }
+}
+
+
+
+task_ptr task_vector::take(size_t Position) {
+    if (Position < _sorted_size()) {
+        return _file.is_open() ? _create_mapped(Position) : std::move(_tasks[Position]);
+    }
+    std::lock_guard<std::mutex> lock(_submit_mutex);
+    return std::move(_submitted[Position - _sorted_size()].task);
+}
+
+
+
+// Children that have no unfinished parents left are returned to the caller in sorted order
+// instead of the ready queue.
+void task_vector::set_done(size_t Position, std::vector<size_t> & OutReady) {
+    if (Position >= _sorted_size()) {
+        _set_submitted_done(Position, OutReady);
+        return;
+    }
+
+    // The done status is set before the cancelled one is read, so either this method sees the task cancelled
+    // or cancel() sees it done (see cancel).
+    _is_done[Position / 64].flags[Position % 64] = true;
+    auto is_cancelled = _is_cancelled[Position / 64].flags[Position % 64].load();
+    if (_file.is_open()) {
+        for (auto child : _file.children(_nodes[Position])) {
+            auto child_pos = _node_positions[child];
+            if (is_cancelled) {
+                _is_cancelled[child_pos / 64].flags[child_pos % 64] = true;
+            }
+            if (--_parents_left[child_pos] == 0) {
+                OutReady.push_back(child_pos);
+            }
+        }
+    }
+    else {
+        for (auto child : _graph.children(Position)) {
+            if (is_cancelled) {
+                _is_cancelled[child / 64].flags[child % 64] = true;
+            }
+            if (--_parents_left[child] == 0) {
+                OutReady.push_back(child);
+            }
+        }
+    }
+
+    // Children submitted after sort(). The flag is read after the done status is set, so either
+    // submit() sees the task done or this method sees the flag (see submit).
+    if (_has_submitted) {
+        std::lock_guard<std::mutex> lock(_submit_mutex);
+        auto it = _submitted_children.find(Position);
+        if (it != _submitted_children.end()) {
+            for (auto child : it->second) {
+                _submitted[child - _sorted_size()].is_cancelled |= is_cancelled;
+                if (--_submitted[child - _sorted_size()].parents_left == 0) {
+                    OutReady.push_back(child);
+                }
+            }
+            _submitted_children.erase(it);
+        }
+    }
+}
+
+
+
+// Parents that are done already aren't waited for: they can be sorted tasks, submitted tasks or tasks
+// that are being executed right now. The flag is set before done statuses are read (see set_done).
+// Returns false if not all parents are present, the task is not added in this case.
+bool task_vector::submit(task_ptr Task, std::vector<size_t> & OutReady) {
+    std::lock_guard<std::mutex> lock(_submit_mutex);
+    auto parent_positions = std::vector<size_t>(Task->parents().size());
+    for (size_t i = 0; i < parent_positions.size(); ++i) {
+        if (!_find_position(Task->parents()[i], parent_positions[i])) return false;
+    }
+    _has_submitted = true;
+
+    auto position = _sorted_size() + _submitted.size();
+    size_t parents_left = 0;
+    auto is_cancelled = false;
+    for (auto par_pos : parent_positions) {
+        if (par_pos < _sorted_size()) {
+            is_cancelled = is_cancelled || _is_cancelled[par_pos / 64].flags[par_pos % 64];
+            if (!_is_done[par_pos / 64].flags[par_pos % 64]) {
+                _submitted_children[par_pos].push_back(position);
+                ++parents_left;
+            }
+        }
+        else {
+            auto & parent = _submitted[par_pos - _sorted_size()];
+            is_cancelled = is_cancelled || parent.is_cancelled;
+            if (!parent.is_done) {
+                parent.children.push_back(position);
+                ++parents_left;
+            }
+        }
+    }
+
+    _positions.emplace(Task->id(), position);
+    auto is_dataflow = Task->is_dataflow();
+    auto has_result = Task->has_result();
+    _submitted.push_back({ std::move(Task), parents_left, false, is_cancelled, {} });
+    if (is_dataflow) {
+        while (_results.size() <= position) {
+            _results.emplace_back();
+        }
+        if (has_result) {
+            _results[position].expect();
+        }
+        _link_task(position);
+    }
+    if (parents_left == 0) {
+        OutReady.push_back(position);
     }
     return true;
 }
 
 
 
-void task_vector::set_done(task_id TaskId) {
-    _is_done[TaskId] = true;
+bool task_vector::submit(task_ptr Task) {
+    _released.clear();
+    if (!submit(std::move(Task), _released)) return false;
+    for (auto pos : _released) {
+        _ready.push(pos);
+    }
+    return true;
+}
+
+
+
+// Only descendants of done tasks are visited: the rest get the status from their parents when these are done.
+// The cancelled status is set before the done one is read (see set_done). Children submitted to a task that is
+// done already are released and aren't reached.
+bool task_vector::cancel(task_id Id) {
+    size_t pos;
+    {
+        std::lock_guard<std::mutex> lock(_submit_mutex);
+        if (_is_cancelled.empty() || !_find_position(Id, pos)) return false;
+    }
+    auto stack = std::vector<size_t>{ pos };
+    while (!stack.empty()) {
+        pos = stack.back();
+        stack.pop_back();
+        if (pos >= _sorted_size()) {
+            std::lock_guard<std::mutex> lock(_submit_mutex);
+            _submitted[pos - _sorted_size()].is_cancelled = true;
+            continue;
+        }
+        if (_is_cancelled[pos / 64].flags[pos % 64].exchange(true) || !_is_done[pos / 64].flags[pos % 64]) continue;
+        if (_file.is_open()) {
+            for (auto child : _file.children(_nodes[pos])) {
+                stack.push_back(_node_positions[child]);
+            }
+        }
+        else {
+            for (auto child : _graph.children(pos)) {
+                stack.push_back(child);
+            }
+        }
+    }
+    return true;
+}
+
+
+
+bool task_vector::is_cancelled(size_t Position) const {
+    if (Position < _sorted_size()) {
+        return _is_cancelled[Position / 64].flags[Position % 64];
+    }
+    std::lock_guard<std::mutex> lock(_submit_mutex);
+    return _submitted[Position - _sorted_size()].is_cancelled;
+}
+
+
+
+task_id task_vector::id(size_t Position) const {
+    if (Position < _sorted_size()) {
+        return _file.is_open() ? _file.id(_nodes[Position]) : _tasks[Position]->id();
+    }
+    std::lock_guard<std::mutex> lock(_submit_mutex);
+    return _submitted[Position - _sorted_size()].task->id();
 }
 
 
@@ -159,6 +1047,158 @@ void task_vector::shuffle() {
     auto seed = (unsigned int) std::chrono::system_clock::now().time_since_epoch().count();
     auto rng = std::default_random_engine(seed);
     std::shuffle(std::begin(_tasks), std::end(_tasks), rng);
+    _is_sorted = false;
+}
+
+
+
+// New tasks get IDs greater than the mapped ones, so submitted tasks don't collide with them.
+bool task_vector::map(const std::string & Path, std::vector<std::function<void(task_id)>> Kinds) {
+    clear();
+    if (!_file.open(Path)) return false;
+    if (_file.kind_count() > Kinds.size()) {
+        _file.close();
+        return false;
+    }
+    _kinds = std::move(Kinds);
+    task::_reserve_ids(_file.max_id());
+    return true;
+}
+
+
+
+bool task_vector::is_mapped() const {
+    return _file.is_open();
+}
+
+
+
+// Each task is placed right after all its ancestors that aren't placed yet. Tasks are processed descending
+// by weights and parents are visited descending by weights as well, so heavy tasks with their chains of
+// ancestors go first as in chained sort. Unlike chained sort, the order of ancestors within a chain is
+// the depth-first post-order rather than level by level, and a parent is never placed after its child.
+// Returns false if not all parents are present or relationships are cyclic.
+bool task_vector::_sort_linear() {
+    _radix_sort_by_weights();
+    if (!_graph.build(_tasks, _positions, _thread_count)) return _fail_build();
+    _graph.order_parents(_thread_count);
+
+    auto order = std::vector<size_t>();
+    if (!_place_graph(order)) return false;
+
+    _apply_order(order);
+    _build_dependencies();
+    return true;
+}
+
+
+
+// Upward rank of a task is its weight plus the largest upward rank of its children (HEFT), see _upward_rank.
+// Tasks are ordered descending by ranks, ties keep the order of the linear sort. Since a parent's rank is
+// not less than its child's rank, the result is a topological order as well.
+bool task_vector::_sort_critical_path() {
+    if (!_sort_linear()) return false;
+
+    // Children go after their parents: compute ranks from the end. A rank depends only on the ranks
+    // of the children, so with several threads tasks are ranked level by level from the tasks without children.
+    auto ranks = std::vector<long long>(_tasks.size());
+    auto rank = [this, &ranks](size_t Position) {
+        auto children = _graph.children(Position);
+        long long longest = children.empty() ? 0 : ranks[*children.begin()];
+        for (auto child : children) {
+            longest = std::max(longest, ranks[child]);
+        }
+        ranks[Position] = _upward_rank(_tasks[Position]->weight(), !children.empty(), longest);
+    };
+    if (_thread_count > 1) {
+        _visit_from_sinks(_graph, _thread_count, rank);
+    }
+    else {
+        for (size_t i = _tasks.size(); i-- > 0;) {
+            rank(i);
+        }
+    }
+
+    // Flip the sign bit to order ranks as unsigned and invert to get descending order.
+    auto keys = std::vector<std::uint64_t>(_tasks.size());
+    auto order = std::vector<size_t>(_tasks.size());
+    parallel_for(_tasks.size(), _thread_count, [&](size_t First, size_t Last) {
+        for (auto i = First; i < Last; ++i) {
+            keys[i] = ~((std::uint64_t) ranks[i] ^ 0x8000000000000000ull);
+            order[i] = i;
+        }
+    });
+    radix_sort(order, keys);
+
+    _apply_order(order);
+    _build_dependencies();
+    return true;
+}
+
+
+
+// The linear sort (and the critical path sort) of a mapped graph: nodes are visited in the file's order by weights
+// and their parents are stored in the same order, so the order is the same as for these tasks emplaced in file order.
+// The file isn't modified: positions are mapped to nodes and back.
+bool task_vector::_sort_mapped(sort_algorithm Algorithm) {
+    _node_positions.clear();
+    if (!_tasks.empty()) return _fail("Tasks submitted to a mapped graph can't be sorted.");
+    if (Algorithm == sort_algorithm::chained) return _fail("The chained sort doesn't support mapped graphs.");
+    auto count = _file.size();
+    auto cycle = std::vector<size_t>();
+    auto parents = [this](size_t Node) { return _file.parents(Node); };
+    if (!_place_after_ancestors(count, _file.by_weight(), parents, _nodes, cycle)) {
+        for (auto node : cycle) {
+            _cycle.push_back(_file.id(node));
+        }
+        return _fail_cycle();
+    }
+    _node_positions.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        _node_positions[_nodes[i]] = i;
+    }
+
+    if (Algorithm == sort_algorithm::critical_path) {
+        // The same ranks as in _sort_critical_path by positions of the linear order.
+        auto ranks = std::vector<long long>(count);
+        for (size_t i = count; i-- > 0;) {
+            auto children = _file.children(_nodes[i]);
+            long long longest = children.empty() ? 0 : ranks[_node_positions[*children.begin()]];
+            for (auto child : children) {
+                longest = std::max(longest, ranks[_node_positions[child]]);
+            }
+            ranks[i] = _upward_rank(_file.weight(_nodes[i]), !children.empty(), longest);
+        }
+        auto keys = std::vector<std::uint64_t>(count);
+        auto order = std::vector<size_t>(count);
+        for (size_t i = 0; i < count; ++i) {
+            keys[i] = ~((std::uint64_t) ranks[i] ^ 0x8000000000000000ull);
+            order[i] = i;
+        }
+        radix_sort(order, keys);
+        for (size_t i = 0; i < count; ++i) {
+            order[i] = _nodes[order[i]];
+        }
+        _nodes.swap(order);
+        for (size_t i = 0; i < count; ++i) {
+            _node_positions[_nodes[i]] = i;
+        }
+    }
+
+    _build_dependencies();
+    return true;
+}
+
+
+
+// Tasks of a mapped graph have no parents: their kinds' functions receive their IDs.
+task_ptr task_vector::_create_mapped(size_t Position) {
+    auto node = _nodes[Position];
+    auto id = _file.id(node);
+    auto tsk = task_ptr(new task(id, _file.weight(node), {}));
+    auto & kind = _kinds[_file.kind(node)];
+    tsk->bind_detached([&kind, id]() { kind(id); });
+    return tsk;
 }
 
 
@@ -173,11 +1213,146 @@ void task_vector::_sort_by_weights() {
 
 
 
-bool task_vector::_parents_ready(size_t Position) {
-    for (auto par_id : _tasks[Position]->parents()) {
-        if (!_is_done[par_id]) return false;
+// Stable sort descending by tasks' weights in O(n).
+void task_vector::_radix_sort_by_weights() {
+    // Flip the sign bit to order ints as unsigned and invert to get descending order.
+    auto keys = std::vector<std::uint32_t>(_tasks.size());
+    auto order = std::vector<size_t>(_tasks.size());
+    parallel_for(_tasks.size(), _thread_count, [&](size_t First, size_t Last) {
+        for (auto i = First; i < Last; ++i) {
+            keys[i] = ~((std::uint32_t) _tasks[i]->weight() ^ 0x80000000u);
+            order[i] = i;
+        }
+    });
+    radix_sort(order, keys);
+    _move_tasks(order);
+}
+
+
+
+// Moves a task from position Order[i] to position i.
+void task_vector::_move_tasks(const std::vector<size_t> & Order) {
+    auto ordered = std::vector<task_ptr>(_tasks.size());
+    parallel_for(Order.size(), _thread_count, [&](size_t First, size_t Last) {
+        for (auto i = First; i < Last; ++i) {
+            ordered[i] = std::move(_tasks[Order[i]]);
+        }
+    });
+    _tasks.swap(ordered);
+}
+
+
+
+void task_vector::_apply_order(const std::vector<size_t> & Order) {
+    _move_tasks(Order);
+
+    auto new_position = _graph.permute(Order, _thread_count);
+    _positions.permute(new_position, _thread_count);
+}
+
+
+
+void task_vector::_build_dependencies() {
+    auto count = _sorted_size();
+    _current_index = 0;
+    _is_done = std::vector<flag_block>((count + 63) / 64);
+    _is_cancelled = std::vector<flag_block>((count + 63) / 64);
+    _parents_left = std::vector<std::atomic_size_t>(count);
+    _ready = decltype(_ready)();
+    parallel_for(count, _thread_count, [&](size_t First, size_t Last) {
+        for (auto i = First; i < Last; ++i) {
+            _parents_left[i] = _file.is_open() ? _file.parents(_nodes[i]).size() : _graph.parents(i).size();
+        }
+    });
+    for (size_t i = 0; i < count; ++i) {
+        if (_parents_left[i] == 0) {
+            _ready.push(i);
+        }
     }
-    return true;
+    _link_results();
+}
+
+
+
+// Dataflow tasks are linked to the storages of their results and of their parents' results in order of parents().
+void task_vector::_link_results() {
+    _results.clear();
+    auto has_dataflow = false;
+    for (auto & tsk : _tasks) {
+        has_dataflow = has_dataflow || tsk->is_dataflow();
+    }
+    if (!has_dataflow) return;
+
+    for (size_t i = 0; i < _tasks.size(); ++i) {
+        _results.emplace_back();
+        if (_tasks[i]->has_result()) {
+            _results[i].expect();
+        }
+    }
+    for (size_t i = 0; i < _tasks.size(); ++i) {
+        _link_task(i);
+    }
+}
+
+
+
+// Results of parents that were released already (a submitted task came late) stay empty:
+// the task throws when it is executed.
+void task_vector::_link_task(size_t Position) {
+    auto & tsk = (*this)[Position];
+    if (!tsk->is_dataflow()) return;
+
+    // The array is released by the task, so it doesn't keep its chunk of the arena alive.
+    auto parents = tsk->parents();
+    auto arguments = parents.empty() ? nullptr :
+        (task_result **) _arena.allocate(parents.size() * sizeof(task_result *), alignof(task_result *));
+    size_t count = 0;
+    for (auto par_id : parents) {
+        size_t par_pos;
+        if (_find_position(par_id, par_pos) && par_pos < _results.size() && _results[par_pos].is_expected()) {
+            _results[par_pos].acquire();
+            arguments[count++] = &_results[par_pos];
+        }
+    }
+    tsk->link_results(tsk->has_result() ? &_results[Position] : nullptr, arguments, count);
+}
+
+
+
+
+// Dispatched tasks can't be sorted again: state used by sort() only is freed before the tasks are executed.
+void task_vector::_start_dispatch() {
+    if (_is_sorted) {
+        _graph.release_parents();
+    }
+    _is_sorted = false;
 }
 
-}
\ No newline at end of file
+
+
+// Submitted tasks become regular tasks to be sorted.
+void task_vector::_merge_submitted() {
+    for (auto & item : _submitted) {
+        _tasks.emplace_back(std::move(item.task));
+    }
+    _has_submitted = false;
+    _submitted.clear();
+    _submitted_children.clear();
+}
+
+
+
+void task_vector::_set_submitted_done(size_t Position, std::vector<size_t> & OutReady) {
+    std::lock_guard<std::mutex> lock(_submit_mutex);
+    auto & done = _submitted[Position - _sorted_size()];
+    done.is_done = true;
+    for (auto child : done.children) {
+        _submitted[child - _sorted_size()].is_cancelled |= done.is_cancelled;
+        if (--_submitted[child - _sorted_size()].parents_left == 0) {
+            OutReady.push_back(child);
+        }
+    }
+    done.children.clear();
+}
+
+}
@@ -1,16 +1,93 @@
 #pragma once
 #include "task.hpp"
+#include "task_graph.hpp"
+#include "task_arena.hpp"
+#include "graph_file.hpp"
 #include <vector>
+#include <deque>
+#include <queue>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <cstdint>
 #include <unordered_map>
 
 namespace qp {
 
-// Not thread-safe.
+enum class sort_algorithm {
+    // Tasks sorted by weights are chained with their ancestors level by level: O( (n+v)*log(n) ).
+    chained,
+    // Tasks sorted by weights with radix sort are placed after their ancestors found by depth-first search: O(n+v).
+    linear,
+    // Tasks are sorted by upward rank - the longest weighted path from a task to a task without children: O(n+v).
+    critical_path
+};
+
+// Not thread-safe, except the methods that are marked as thread-safe.
 class task_vector {
 private:
+    // Statuses of 64 tasks in one cache line.
+    struct alignas(64) flag_block {
+        std::atomic_bool flags[64];
+    };
+
     size_t _current_index;
+
+    // Tasks emplaced by weight and parents are allocated here. Declared before the tasks to be destroyed after them.
+    task_arena _arena;
     std::vector<task_ptr> _tasks;
-    std::unordered_map<task_id, std::atomic_bool> _is_done;
+
+    // True after a successful sort() until tasks are added, shuffled or dispatched.
+    bool _is_sorted;
+
+    // Number of threads used by the last sort().
+    int _thread_count;
+
+    // Why the last sort() failed and IDs of the cycle it found.
+    std::string _sort_error;
+    std::vector<task_id> _cycle;
+
+    // Done and cancelled statuses by tasks' positions (in sorted order).
+    std::vector<flag_block> _is_done;
+    std::vector<flag_block> _is_cancelled;
+
+    // Dependencies compiled by sort(): tasks' positions by their IDs,
+    // relationships by positions and number of unfinished parents of each task.
+    id_index _positions;
+    task_graph _graph;
+    std::vector<std::atomic_size_t> _parents_left;
+
+    // A graph mapped from a file instead of tasks: tasks are created by their kinds when they are dispatched.
+    // Nodes (indices in the file) by positions and positions by nodes are set by sort().
+    graph_file _file;
+    std::vector<std::function<void(task_id)>> _kinds;
+    std::vector<size_t> _nodes;
+    std::vector<size_t> _node_positions;
+
+    // Results of dataflow tasks by positions, created by sort() if there are dataflow tasks.
+    // A deque: submitted tasks add results without moving the existing ones.
+    std::deque<task_result> _results;
+
+    // Positions of tasks whose parents are all done. The smallest position (the first in sorted order) is on top.
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> _ready;
+
+    // A task submitted after sort(). Its position goes after the sorted tasks in order of submission.
+    struct submitted_task {
+        task_ptr task;
+        size_t parents_left;
+        bool is_done;
+        bool is_cancelled;
+        std::vector<size_t> children;
+    };
+
+    // Submitted tasks and children of sorted tasks that were submitted after sort().
+    // Guarded by _submit_mutex, thread-safe methods lock it only when submitted tasks are involved.
+    mutable std::mutex _submit_mutex;
+    std::atomic_bool _has_submitted;
+    std::deque<submitted_task> _submitted;
+    std::unordered_map<size_t, std::vector<size_t>> _submitted_children;
+    std::vector<size_t> _released;
 
 public:
     task_vector();
@@ -20,19 +97,127 @@ public:
     task_vector & operator=(const task_vector & TaskVector) = delete;
 
     void emplace(task_ptr Task);
+
+    // Create a task with its parents in the task vector's arena: no allocations per task.
+    // The tasks are freed by clear() or the destructor, they must not outlive the task vector.
+    task & emplace(int Weight);
+    task & emplace(int Weight, task_id ParentId);
+    task & emplace(int Weight, const std::vector<task_id> & ParentId);
+    task & emplace(int Weight, id_range ParentId);
+
+    // Appends Count tasks created by Make(i) for i in [0, Count), called by ThreadCount threads in parallel.
+    // Tasks are placed in order of i whatever thread creates them. Make must be thread-safe.
+    // If it throws, no tasks are added and the first exception is rethrown.
+    void generate(size_t Count, const std::function<task_ptr(size_t)> & Make, int ThreadCount = 1);
     task_ptr & operator[](size_t i);
     void clear();
     void reserve(size_t Size);
     size_t size() const;
-    bool sort();
-    bool pop_next(task_ptr & OutTask);
-    void set_done(task_id TaskId);
+
+    // Resolving IDs, compiling relationships, placing and reordering them are done by ThreadCount threads,
+    // the order doesn't depend on the number of threads. Placing scales unless a task sorted early is a descendant
+    // of most of the graph (e.g. a heavy common sink): its ancestors are placed by one thread. Returns false if IDs
+    // repeat, not all parents are present or relationships are cyclic.
+    bool sort(sort_algorithm Algorithm = sort_algorithm::linear, int ThreadCount = 1);
+    bool is_sorted() const;
+
+    // Why the last sort() failed: a repeated ID, a missing parent or a cycle with its tasks' IDs. Empty if it succeeded.
+    const std::string & sort_error() const;
+
+    // IDs of the tasks of a cycle found by the last sort(): each task is a parent of the next one,
+    // the last one is a parent of the first one. Empty if no cycle was found.
+    const std::vector<task_id> & cycle() const;
+
+    // Writes the order and relationships compiled by sort() to a binary snapshot. Returns false if the task vector
+    // isn't sorted, is mapped or the file can't be written.
+    bool save_order(const std::string & Path) const;
+
+    // Places the tasks in the order of a snapshot and restores their relationships instead of sorting them.
+    // The tasks must have the same IDs and parents (checked by a hash) as the saved ones, the saved relationships
+    // must match the parents, weights aren't checked.
+    // Returns false and keeps the tasks as they are otherwise.
+    bool load_order(const std::string & Path);
+    bool pop_next(task_ptr & OutTask, size_t & OutPosition);
+    void set_done(size_t Position);
+
+    // Children pushed to the ready queue by the last set_done(Position), or the task pushed by the last submit(Task).
+    const std::vector<size_t> & released() const;
+    bool is_done(size_t Position) const;
+
+    // Number of tasks in the ready queue.
+    size_t ready_count() const;
+
+    // Weight of a sorted task that isn't dispatched yet.
+    int weight(size_t Position) const;
+
+    // Positions of the heaviest chain of sorted tasks (weights summed), from a task without parents
+    // to a task without children. Call it after sort() and before dispatching.
+    std::vector<size_t> critical_path() const;
+
+    // The same with costs by positions instead of weights (e.g. measured durations), may be called after dispatching.
+    std::vector<size_t> critical_path(const std::vector<std::uint64_t> & Costs) const;
     void shuffle();
 
+    // Replaces the content with a graph written by graph_builder. The file is mapped, not loaded: sort() and dispatching
+    // read it, a task is created when it is dispatched and calls Kinds[kind] with its ID.
+    // Only submitted tasks can be added to a mapped graph (operator[] doesn't return mapped tasks), the chained sort
+    // isn't supported. Returns false if the file can't be mapped, is corrupt or refers to a kind missing in Kinds.
+    bool map(const std::string & Path, std::vector<std::function<void(task_id)>> Kinds);
+    bool is_mapped() const;
+
+    // Thread-safe for distinct tasks: used by workers that keep their own queues of positions.
+    void pop_ready(std::vector<size_t> & OutPositions);
+    task_ptr take(size_t Position);
+    void set_done(size_t Position, std::vector<size_t> & OutReady);
+    bool submit(task_ptr Task, std::vector<size_t> & OutReady);
+
+    // Marks a task and its descendants as cancelled: a task done with this status passes it to its children before
+    // they are released, so the whole subtree gets it by the time its tasks are dispatched. Descendants of a task that is
+    // done already are marked at once. Returns false if there is no such task or the task vector isn't sorted.
+    bool cancel(task_id Id);
+    bool is_cancelled(size_t Position) const;
+
+    // ID of a task that isn't dispatched yet.
+    task_id id(size_t Position) const;
+
+    // Adds a task to a sorted task vector, the task is pushed to the ready queue if its parents are done.
+    bool submit(task_ptr Task);
+
+    // Result of a dataflow task that hasn't been released yet (results of tasks without dataflow children are kept).
+    // Returns nullptr if there is no such result or it has a different type.
+    template<class T>
+    T * result(task_id Id) {
+        size_t pos;
+        if (!_find_position(Id, pos) || pos >= _results.size()) return nullptr;
+        return _results[pos].get<T>();
+    }
+
 private:
+    task & _emplace_in_arena(int Weight, const task_id * ParentId, size_t ParentCount);
+    size_t _sorted_size() const;
+    bool _find_position(task_id Id, size_t & OutPosition) const;
+    bool _fail(std::string Error);
+    bool _fail_build();
+    bool _fail_cycle();
+    bool _place_graph(std::vector<size_t> & Order);
+    bool _sort_chained();
+    bool _sort_linear();
+    bool _sort_critical_path();
+    bool _sort_mapped(sort_algorithm Algorithm);
+    task_ptr _create_mapped(size_t Position);
     void _sort_by_weights();
-    bool _parents_ready(size_t Position);
+    void _radix_sort_by_weights();
+    void _move_tasks(const std::vector<size_t> & Order);
+    void _apply_order(const std::vector<size_t> & Order);
+    void _build_dependencies();
+    void _link_results();
+    void _link_task(size_t Position);
+    void _start_dispatch();
+    void _merge_submitted();
+    void _set_submitted_done(size_t Position, std::vector<size_t> & OutReady);
+    template<class CostFunc>
+    std::vector<size_t> _heaviest_chain(const CostFunc & Cost) const;
 
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,175 @@
+#include "thread_pool.hpp"
+
+namespace qp {
+
+graph_state::graph_state(task_vector && TaskVector) :
+    tasks(std::move(TaskVector)),
+    tasks_left(0),
+    is_done(false) {}
+
+
+
+graph_handle::graph_handle(std::shared_ptr<graph_state> State) :
+    _state(std::move(State)) {}
+
+
+
+failure_report graph_handle::wait() {
+    std::unique_lock<std::mutex> lock(_state->mutex);
+    _state->cv.wait(lock, [this]{ return _state->is_done; });
+    return _state->report;
+}
+
+
+
+bool graph_handle::is_done() const {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    return _state->is_done;
+}
+
+
+
+thread_pool::thread_pool(int ThreadCount) :
+    _thread_count(std::max(1, ThreadCount)),
+    _is_running(true)
+{
+    for (int i = 0; i < _thread_count; ++i) {
+        _thread_pool.emplace_back(
+            [this] { _start_infinite_loop(); }
+        );
+    }
+}
+
+
+
+// Finishes all launched graphs and joins the threads.
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _is_running = false;
+    }
+    _cv.notify_all();
+    for(std::thread & thread : _thread_pool) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+
+
+// Sorts the tasks (unless they are sorted already) with as many threads as the pool has, started by the calling thread,
+// and passes them to the pool's threads.
+graph_handle thread_pool::run(task_vector && TaskVector, sort_algorithm Algorithm) {
+    auto graph = std::make_shared<graph_state>(std::move(TaskVector));
+    if (!graph->tasks.is_sorted() && !graph->tasks.sort(Algorithm, _thread_count)) {
+        throw std::runtime_error(graph->tasks.sort_error());
+    }
+    graph->tasks_left = graph->tasks.size();
+
+    // Nothing to execute.
+    if (graph->tasks_left == 0) {
+        graph->is_done = true;
+        return graph_handle(graph);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _graphs.push_back(graph);
+    }
+    _cv.notify_all();
+    return graph_handle(graph);
+}
+
+
+
+int thread_pool::thread_count() const {
+    return _thread_count;
+}
+
+
+
+void thread_pool::_start_infinite_loop() {
+    while (true) {
+        std::shared_ptr<graph_state> graph;
+        task_ptr temp_task;
+        size_t temp_position;
+        {
+            // Wait for a ready task in any graph. Threads leave when all graphs are done.
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [&]{
+                return _pop_next(graph, temp_task, temp_position) || (!_is_running && _graphs.empty());
+            });
+            if (temp_task == nullptr) return;
+        }
+
+        // There may be more ready tasks - give a way to another thread.
+        // Dependents of a failed task are skipped: the failed task is cancelled, its children get the status
+        // when it's done.
+        _cv.notify_one();
+        if (graph->tasks.is_cancelled(temp_position)) {
+            temp_task->skip();
+            std::lock_guard<std::mutex> lock(_mutex);
+            graph->report.skipped.push_back(temp_task->id());
+        }
+        else {
+            try {
+                temp_task->execute();
+            }
+            catch (...) {
+                graph->tasks.cancel(temp_task->id());
+                std::lock_guard<std::mutex> lock(_mutex);
+                graph->report.failures.push_back({ temp_task->id(), 1, std::current_exception(),
+                                                   describe_current_exception() });
+            }
+        }
+        temp_task.reset();
+        _set_done(graph, temp_position);
+    }
+}
+
+
+
+// Takes the next ready task from the graphs in turn. Requires _mutex to be locked.
+bool thread_pool::_pop_next(std::shared_ptr<graph_state> & OutGraph, task_ptr & OutTask, size_t & OutPosition) {
+    for (size_t i = 0; i < _graphs.size(); ++i) {
+        auto graph = _graphs.front();
+        // The graph goes to the end of the list: the next task is taken from another graph.
+        _graphs.splice(_graphs.end(), _graphs, _graphs.begin());
+        graph->tasks.pop_next(OutTask, OutPosition);
+        if (OutTask != nullptr) {
+            OutGraph = std::move(graph);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+void thread_pool::_set_done(const std::shared_ptr<graph_state> & Graph, size_t Position) {
+    auto is_done = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Graph->tasks.set_done(Position);
+        if (--Graph->tasks_left == 0) {
+            _graphs.remove(Graph);
+            is_done = true;
+        }
+    }
+
+    if (is_done) {
+        {
+            std::lock_guard<std::mutex> lock(Graph->mutex);
+            Graph->is_done = true;
+        }
+        Graph->cv.notify_all();
+        // Threads may be waiting for the last graph to be done to leave.
+        _cv.notify_all();
+    }
+    else {
+        _cv.notify_one();
+    }
+}
+
+}
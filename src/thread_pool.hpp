@@ -0,0 +1,78 @@
+#pragma once
+#include "task.hpp"
+#include "task_vector.hpp"
+#include "failure_report.hpp"
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <list>
+
+namespace qp {
+
+// A task graph launched by a thread_pool.
+struct graph_state {
+public:
+    task_vector tasks;
+    // Number of tasks that aren't done yet. Guarded by the pool's mutex.
+    size_t tasks_left;
+
+    // Failed and skipped tasks. Guarded by the pool's mutex until the graph is done.
+    failure_report report;
+
+    // Completion status for graph_handle.
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool is_done;
+
+public:
+    graph_state(task_vector && TaskVector);
+
+};
+
+// Completion handle of a task graph launched by a thread_pool.
+class graph_handle {
+private:
+    std::shared_ptr<graph_state> _state;
+
+public:
+    graph_handle(std::shared_ptr<graph_state> State);
+
+    // Waits for all tasks of the graph. Returns its failures and the dependents of failed tasks that were skipped.
+    failure_report wait();
+    bool is_done() const;
+
+    // Result of a dataflow task of the graph, see task_vector::result. Call it after wait().
+    template<class T>
+    T * result(task_id Id) const {
+        return _state->tasks.template result<T>(Id);
+    }
+
+};
+
+// Long-lived threads executing any number of task graphs one after another or at the same time.
+class thread_pool {
+private:
+    int _thread_count;
+    bool _is_running;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::list<std::shared_ptr<graph_state>> _graphs;
+    std::vector<std::thread> _thread_pool;
+
+public:
+    thread_pool(int ThreadCount = 1);
+    thread_pool(const thread_pool & ThreadPool) = delete;
+    thread_pool & operator=(const thread_pool & ThreadPool) = delete;
+    graph_handle run(task_vector && TaskVector, sort_algorithm Algorithm = sort_algorithm::linear);
+    int thread_count() const;
+    virtual ~thread_pool();
+
+private:
+    void _start_infinite_loop();
+    bool _pop_next(std::shared_ptr<graph_state> & OutGraph, task_ptr & OutTask, size_t & OutPosition);
+    void _set_done(const std::shared_ptr<graph_state> & Graph, size_t Position);
+
+};
+
+}
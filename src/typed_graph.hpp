@@ -0,0 +1,222 @@
+#pragma once
+#include "task_vector.hpp"
+#include "task_manager.hpp"
+#include <tuple>
+#include <array>
+#include <optional>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+namespace qp {
+
+// A node of a typed_graph: a function called with the results of the nodes at indices Parents...
+// Parents must precede the node in the graph, so a typed graph can't be cyclic.
+template<class Func, size_t ... Parents>
+struct typed_node {
+public:
+    using function = Func;
+    using parents = std::index_sequence<Parents...>;
+
+    int weight;
+    Func func;
+
+public:
+    // Number of times the node at index I is a parent of this node.
+    template<size_t I>
+    static constexpr size_t parent_count = ((Parents == I ? 1 : 0) + ... + 0);
+
+};
+
+// Creates a node with the given weight whose function receives results of the nodes at indices Parents...
+template<size_t ... Parents, class Func>
+typed_node<std::decay_t<Func>, Parents...> node(int weight, Func && func) {
+    return { weight, std::forward<Func>(func) };
+}
+
+// Storage of a node's result. Nodes returning void have nothing to store.
+template<class T>
+struct typed_slot {
+    std::optional<T> value;
+};
+
+template<>
+struct typed_slot<void> {};
+
+// A result passed to children as a tuple with a reference: rvalue for a single child, const lvalue for several ones.
+// Results of void functions are passed as empty tuples.
+template<class T, size_t ConsumerCount>
+struct typed_argument {
+    using type = std::conditional_t<ConsumerCount == 1, std::tuple<T &&>, std::tuple<const T &>>;
+};
+
+template<size_t ConsumerCount>
+struct typed_argument<void, ConsumerCount> {
+    using type = std::tuple<>;
+};
+
+// A graph whose shape and types are known at compile time. Children receive their parents' results
+// as arguments: by rvalue reference if the parent has only one child (the result is moved from the graph),
+// by const reference otherwise. Results of void functions aren't passed.
+// Tasks call nodes' functions directly, so no futures and no type erasure are involved besides the tasks' callables.
+template<class ... Nodes>
+class typed_graph {
+private:
+    using node_tuple = std::tuple<Nodes...>;
+
+    template<size_t I>
+    using node_type = std::tuple_element_t<I, node_tuple>;
+
+    // Number of children of the node at index I.
+    template<size_t I>
+    static constexpr size_t _consumer_count = (Nodes::template parent_count<I> + ... + 0);
+
+    template<size_t I>
+    struct result_of;
+
+    template<size_t I>
+    using argument_type = typename typed_argument<typename result_of<I>::type, _consumer_count<I>>::type;
+
+    template<class Func, class Parents>
+    struct invoke_result;
+
+    template<class Func, size_t ... Parents>
+    struct invoke_result<Func, std::index_sequence<Parents...>> {
+        using type = decltype(std::apply(std::declval<Func &>(),
+                                         std::tuple_cat(std::declval<argument_type<Parents>>()...)));
+    };
+
+    template<size_t I>
+    struct result_of {
+        using type = typename invoke_result<typename node_type<I>::function, typename node_type<I>::parents>::type;
+    };
+
+    template<class Sequence>
+    struct slot_tuple;
+
+    template<size_t ... I>
+    struct slot_tuple<std::index_sequence<I...>> {
+        using type = std::tuple<typed_slot<typename result_of<I>::type>...>;
+    };
+
+    using indices = std::index_sequence_for<Nodes...>;
+
+    node_tuple _nodes;
+    typename slot_tuple<indices>::type _slots;
+    std::array<task_id, sizeof...(Nodes)> _ids;
+
+public:
+    template<size_t I>
+    using result_type = typename result_of<I>::type;
+
+    typed_graph(Nodes ... nodes) :
+        _nodes(std::move(nodes)...),
+        _slots(),
+        _ids() {
+        _check_parents(indices());
+    }
+
+    typed_graph(const typed_graph & TypedGraph) = delete;
+    typed_graph & operator=(const typed_graph & TypedGraph) = delete;
+
+    static constexpr size_t size() { return sizeof...(Nodes); }
+
+    // Creates a task per node in Out. Results are stored in the graph: it must outlive the tasks' execution.
+    void emplace_tasks(task_vector & Out) {
+        _emplace_tasks(Out, indices());
+    }
+
+    // Calls the nodes one by one in the calling thread.
+    void run() {
+        _run(indices());
+    }
+
+    // Executes the nodes with a task_manager and waits for them. Dependents of a node that throws are skipped,
+    // then the exception of the first failed node is rethrown as by run().
+    void run(int ThreadCount, schedule_mode Mode = schedule_mode::shared_queue) {
+        auto tasks = task_vector();
+        emplace_tasks(tasks);
+        auto manager = task_manager(std::move(tasks), ThreadCount, Mode);
+        manager.run();
+        manager.wait().rethrow();
+    }
+
+    // Result of the node at index I. Results moved to a single child aren't valid anymore.
+    template<size_t I>
+    result_type<I> & result() {
+        return *std::get<I>(_slots).value;
+    }
+
+    // ID of the task created for the node at index I by emplace_tasks.
+    template<size_t I>
+    task_id id() const {
+        return _ids[I];
+    }
+
+private:
+    template<size_t ... I>
+    static constexpr void _check_parents(std::index_sequence<I...>) {
+        static_assert((_precede_node<I>(typename node_type<I>::parents()) && ...),
+                      "Parents of a typed_graph's node must precede it.");
+    }
+
+    template<size_t I, size_t ... Parents>
+    static constexpr bool _precede_node(std::index_sequence<Parents...>) {
+        return ((Parents < I) && ...);
+    }
+
+    template<size_t ... I>
+    void _emplace_tasks(task_vector & Out, std::index_sequence<I...>) {
+        (_emplace_task<I>(Out, typename node_type<I>::parents()), ...);
+    }
+
+    template<size_t I, size_t ... Parents>
+    void _emplace_task(task_vector & Out, std::index_sequence<Parents...>) {
+        auto parent_ids = std::array<task_id, sizeof...(Parents)> { _ids[Parents]... };
+        auto & tsk = Out.emplace(std::get<I>(_nodes).weight,
+                                 id_range{ parent_ids.data(), parent_ids.data() + parent_ids.size() });
+        tsk.bind_detached([this]() { _invoke<I>(); });
+        _ids[I] = tsk.id();
+    }
+
+    template<size_t ... I>
+    void _run(std::index_sequence<I...>) {
+        (_invoke<I>(), ...);
+    }
+
+    template<size_t I>
+    void _invoke() {
+        _invoke<I>(typename node_type<I>::parents());
+    }
+
+    template<size_t I, size_t ... Parents>
+    void _invoke(std::index_sequence<Parents...>) {
+        auto & func = std::get<I>(_nodes).func;
+        auto arguments = std::tuple_cat(_argument<Parents>()...);
+        if constexpr (std::is_void_v<result_type<I>>) {
+            std::apply(func, std::move(arguments));
+        }
+        else {
+            std::get<I>(_slots).value.emplace(std::apply(func, std::move(arguments)));
+        }
+    }
+
+    template<size_t I>
+    argument_type<I> _argument() {
+        if constexpr (std::is_void_v<result_type<I>>) {
+            return {};
+        }
+        else if constexpr (_consumer_count<I> == 1) {
+            return argument_type<I>(std::move(*std::get<I>(_slots).value));
+        }
+        else {
+            return argument_type<I>(*std::get<I>(_slots).value);
+        }
+    }
+
+};
+
+template<class ... Nodes>
+typed_graph(Nodes ...) -> typed_graph<Nodes...>;
+
+}
@@ -0,0 +1,33 @@
+#include "worker_queue.hpp"
+
+namespace qp {
+
+size_t worker_queue::push(const std::vector<size_t> & Positions) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = Positions.rbegin(); it != Positions.rend(); ++it) {
+        positions.push_back(*it);
+    }
+    return positions.size();
+}
+
+
+
+bool worker_queue::pop(size_t & OutPosition) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (positions.empty()) return false;
+    OutPosition = positions.back();
+    positions.pop_back();
+    return true;
+}
+
+
+
+bool worker_queue::steal(size_t & OutPosition) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (positions.empty()) return false;
+    OutPosition = positions.front();
+    positions.pop_front();
+    return true;
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace qp {
+
+// A deque of tasks (positions in a sorted task_vector) owned by one worker thread.
+// The owner works with the back of the deque, other workers steal from the front.
+// Aligned to a cache line to keep neighbouring workers' queues apart.
+struct alignas(64) worker_queue {
+public:
+    std::mutex mutex;
+    std::deque<size_t> positions;
+
+public:
+    // Pushes tasks given in sorted order so that the first of them is popped first.
+    // Returns the number of tasks in the queue after pushing.
+    size_t push(const std::vector<size_t> & Positions);
+
+    // Pops the task pushed last (owner's side).
+    bool pop(size_t & OutPosition);
+
+    // Steals the task pushed first (thief's side).
+    bool steal(size_t & OutPosition);
+
+};
+
+}
@@ -4,9 +4,28 @@
 
 void test() {
     qp::test::task_sort_order();
+    qp::test::task_vector_arena();
+    qp::test::task_vector_mapped();
+    qp::test::task_vector_snapshot();
+    qp::test::task_vector_generate();
+    qp::test::task_vector_cycle();
     qp::test::task_manager_wait();
-    //qp::test::sort_performance("sort_performance.csv");
+    qp::test::task_manager_work_stealing();
+    qp::test::task_manager_submit();
+    qp::test::thread_pool_graphs();
+    qp::test::typed_graph_pipeline();
+    qp::test::task_vector_dataflow();
+    qp::test::task_manager_trace();
+    qp::test::task_manager_metrics();
+    qp::test::task_manager_report();
+    qp::test::task_manager_cancel();
+    qp::test::task_manager_failures();
+    //qp::test::sort_performance("sort_performance.csv", 8);
     //qp::test::performance_vs_thread(64, "performance_vs_thread.csv");
+    //qp::test::performance_vs_thread(65, "performance_vs_thread_stealing.csv", qp::schedule_mode::work_stealing);
+    //qp::test::dispatch_performance("dispatch_performance.csv");
+    //qp::test::performance_vs_priority(9, "performance_vs_priority.csv");
+    //qp::test::performance_vs_graph_count("performance_vs_graph_count.csv");
     //qp::test::performance_vs_set_size_fixed_total_runtime("performance_vs_set_size_fixed_total_runtime.csv");
     //qp::test::performance_vs_set_size_fixed_task_duration("performance_vs_set_size_fixed_task_duraton.csv");
     //qp::test::performance_vs_task_duration("performance_vs_task_duration.csv");
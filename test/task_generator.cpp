@@ -120,6 +120,34 @@ void task_generator::test_set_no_parent_equal(size_t set_size, long total_millis
 
 
 
+// A wide graph of one component: all tasks are children of the 1st one.
+void task_generator::test_set_single_root(size_t set_size, long total_millisec, bool print_job, task_vector & out) {
+    // Prepare output.
+    out.clear();
+    out.reserve(set_size);
+
+    // Common difference d.
+    int d = (int) ((2 * total_millisec) / (set_size * (set_size + 1)));
+
+    // Place the root.
+    auto tsk = std::make_unique<task>(d);
+    auto root_id = tsk->id();
+    tsk->bind(job, print_job, tsk->id(), tsk->weight(), tsk->parents());
+    out.emplace(std::move(tsk));
+
+    // Place rest of the tasks.
+    for (int i = 2; i <= set_size; ++i) {
+        tsk = std::make_unique<task>(i*d, root_id);
+        tsk->bind(job, print_job, tsk->id(), tsk->weight(), tsk->parents());
+        out.emplace(std::move(tsk));
+    }
+
+    // Shuffle.
+    out.shuffle();
+}
+
+
+
 void task_generator::test_set_random_singleparent(size_t set_size, long total_millisec, bool print_job, task_vector & out) {
     // Prepare output.
     out.clear();
@@ -18,6 +18,7 @@ public:
     static void test_set_worst_multiparent(size_t set_size, long total_millisec, bool print_job, task_vector & out);
     static void test_set_no_parent(size_t set_size, long total_millisec, bool print_job, task_vector & out);
     static void test_set_no_parent_equal(size_t set_size, long total_millisec, bool print_job, task_vector & out);
+    static void test_set_single_root(size_t set_size, long total_millisec, bool print_job, task_vector & out);
     static void test_set_random_singleparent(size_t set_size, long total_millisec, bool print_job, task_vector & out);
     static void test_set_random_multiparent(size_t set_size, long total_millisec, bool print_job, task_vector & out);
     static void test_set_custom(bool print_job, task_vector & out);
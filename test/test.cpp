@@ -5,8 +5,11 @@
 #include <algorithm>
 #include <iostream>
 #include <fstream>
-#include <ctime>
 #include <sstream>
+#include <cstdio>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
 
 namespace qp {
 
@@ -50,6 +53,35 @@ void test::task_sort_order() {
     _printline("   > after sorting ");
     cout_tasks(tasks);
 
+    // Random multi parent, critical path.
+    _printline("   > sorting random multi parent by critical path");
+    task_generator::test_set_random_multiparent(5, 1000, false, tasks);
+    _printline("   > initial set ");
+    cout_tasks(tasks);
+    tasks.sort(sort_algorithm::critical_path);
+    _printline("   > after sorting ");
+    cout_tasks(tasks);
+
+    // Negative weights, critical path: parents still go first, the heaviest chain is B -> C.
+    _printline("   > sorting negative weights by critical path");
+    tasks.clear();
+    auto & a = tasks.emplace(-5);
+    auto & b = tasks.emplace(10, a.id());
+    auto & c = tasks.emplace(-3, b.id());
+    tasks.emplace(1);
+    auto chain = std::vector<task_id>{ a.id(), b.id(), c.id() };
+    tasks.sort(sort_algorithm::critical_path);
+    cout_tasks(tasks);
+    auto position = std::unordered_map<task_id, size_t>();
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        position[tasks[i]->id()] = i;
+    }
+    auto path = tasks.critical_path();
+    auto is_topological = position[chain[0]] < position[chain[1]] && position[chain[1]] < position[chain[2]];
+    auto is_heaviest = path == std::vector<size_t>{ position[chain[1]], position[chain[2]] };
+    _printline(std::string("   > parents first: ") + (is_topological ? "yes" : "no") + ", critical path B -> C: " +
+               (is_heaviest ? "yes" : "no"));
+
     // No parents.
     _printline("   > sorting no parents");
     task_generator::test_set_no_parent(5, 1000, false, tasks);
@@ -62,6 +94,254 @@ void test::task_sort_order() {
 
 
 
+void test::task_vector_arena() {
+    _printline("Test1a: task_vector - tasks created in arena");
+    auto tasks = task_vector();
+    auto & first = tasks.emplace(10);
+    first.bind(task_generator::job, true, first.id(), first.weight(), first.parents());
+    auto & second = tasks.emplace(30);
+    second.bind(task_generator::job, true, second.id(), second.weight(), second.parents());
+    auto & third = tasks.emplace(20, first.id());
+    third.bind(task_generator::job, true, third.id(), third.weight(), third.parents());
+    auto & fourth = tasks.emplace(40, std::vector<task_id> { second.id(), third.id() });
+    fourth.bind(task_generator::job, true, fourth.id(), fourth.weight(), fourth.parents());
+    tasks.emplace(std::make_unique<task>(5, first.id()));
+    _printline("   > initial set ");
+    cout_tasks(tasks);
+    tasks.sort();
+    _printline("   > after sorting ");
+    cout_tasks(tasks);
+    auto manager = task_manager(std::move(tasks), 2);
+    manager.run();
+    manager.wait();
+    _printline("   > this should appear after the task with 2 parents finished");
+}
+
+
+
+// The mapped graph is a copy of a generated set: both are dispatched in one thread in the same order,
+// generated tasks aren't executed.
+void test::task_vector_mapped() {
+    _printline("Test1b: task_vector - graph mapped from a file");
+    auto tasks = task_vector();
+    auto set_size = 1000;
+    task_generator::test_set_random_multiparent(set_size, (long) set_size * (set_size + 1) / 2, false, tasks);
+    auto builder = graph_builder();
+    for (auto i = 0; i < set_size; ++i) {
+        builder.add(tasks[i]->id(), tasks[i]->weight(), i % 2, tasks[i]->parents());
+    }
+    auto path = std::string("task_vector_mapped.qpg");
+    _printline(std::string("   > graph is written: ") + (builder.write(path) ? "yes" : "no"));
+
+    auto mapped = task_vector();
+    // Counted by several workers at once in the rerun.
+    auto executed = std::vector<std::atomic_int>(2);
+    auto is_mapped = mapped.map(path, {
+        [&executed](task_id) { ++executed[0]; },
+        [&executed](task_id) { ++executed[1]; }
+    });
+    _printline(std::string("   > graph is mapped: ") + (is_mapped ? "yes" : "no"));
+
+    auto orders = std::vector<std::vector<task_id>>(2);
+    auto sets = { &tasks, &mapped };
+    auto order = orders.begin();
+    for (auto set : sets) {
+        set->sort();
+        task_ptr tsk;
+        size_t pos;
+        auto has_next = true;
+        while (has_next) {
+            tsk.reset();
+            has_next = set->pop_next(tsk, pos);
+            if (tsk != nullptr) {
+                order->push_back(tsk->id());
+                if (set == &mapped) tsk->execute();
+                set->set_done(pos);
+            }
+        }
+        ++order;
+    }
+    _printline(std::string("   > same order as the generated set: ") + (orders[0] == orders[1] ? "yes" : "no"));
+    _printline("   > executed by kinds: " + std::to_string(executed[0]) + " + " + std::to_string(executed[1]) +
+               " (should be " + std::to_string(set_size / 2) + " + " + std::to_string(set_size / 2) + ")");
+
+    // Dispatched again by a task_manager: the mapping isn't changed by dispatching.
+    auto manager = task_manager(std::move(mapped), 4, schedule_mode::work_stealing, sort_algorithm::critical_path);
+    manager.run();
+    manager.wait();
+    _printline("   > executed after rerun: " + std::to_string(executed[0] + executed[1]) +
+               " (should be " + std::to_string(2 * set_size) + ")");
+
+    // The last child's index is overwritten with another node of the graph, then with a node beyond the graph.
+    auto is_corrupt_mapped = std::vector<bool>();
+    for (auto is_beyond : { false, true }) {
+        {
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            std::uint64_t node = 0;
+            file.seekg(-8, std::ios::end);
+            file.read((char *) &node, sizeof(node));
+            node = is_beyond ? ~(std::uint64_t) 0 : (node + 1) % set_size;
+            file.seekp(-8, std::ios::end);
+            file.write((const char *) &node, sizeof(node));
+        }
+        auto corrupt = task_vector();
+        is_corrupt_mapped.push_back(corrupt.map(path, { [](task_id) {}, [](task_id) {} }));
+    }
+    _printline(std::string("   > corrupt graph is mapped: ") + (is_corrupt_mapped[0] ? "yes" : "no") + ", " +
+               (is_corrupt_mapped[1] ? "yes" : "no") + " (should be no, no)");
+    std::remove(path.c_str());
+}
+
+
+
+// The same tasks are shuffled and placed in the saved order without sorting.
+void test::task_vector_snapshot() {
+    _printline("Test1c: task_vector - saved order reloaded instead of sorting");
+    auto tasks = task_vector();
+    auto set_size = 5000;
+    task_generator::test_set_random_multiparent(set_size, (long) set_size * (set_size + 1) / 2, false, tasks);
+    auto timer = std::chrono::steady_clock::now();
+    tasks.sort();
+    auto sort_time = _elapsed(timer);
+    auto sorted = std::vector<task_id>();
+    for (auto i = 0; i < set_size; ++i) {
+        sorted.push_back(tasks[i]->id());
+    }
+    auto path = std::string("task_vector_snapshot.qpo");
+    _printline(std::string("   > order is saved: ") + (tasks.save_order(path) ? "yes" : "no"));
+
+    tasks.shuffle();
+    timer = std::chrono::steady_clock::now();
+    auto is_loaded = tasks.load_order(path);
+    auto load_time = _elapsed(timer);
+    auto is_same = is_loaded && tasks.is_sorted();
+    for (auto i = 0; is_same && i < set_size; ++i) {
+        is_same = tasks[i]->id() == sorted[i];
+    }
+    _printline(std::string("   > order is loaded: ") + (is_same ? "yes" : "no"));
+    _printline("   > sort: " + std::to_string(sort_time) + " s, load: " + std::to_string(load_time) + " s");
+
+    // The edge count of the header (after the magic, the version and the task count) is overwritten.
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(24);
+        auto edge_count = ~(std::uint64_t) 0 / 16;
+        file.write((const char *) &edge_count, sizeof(edge_count));
+    }
+    tasks.shuffle();
+    _printline(std::string("   > corrupt snapshot is rejected: ") + (tasks.load_order(path) ? "no" : "yes"));
+
+    // The edge count is restored, the first parent's position is changed: the hash of the tasks still matches.
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        auto edge_count = (std::uint64_t) 0;
+        for (auto i = 0; i < set_size; ++i) {
+            edge_count += tasks[i]->parents().size();
+        }
+        file.seekp(24);
+        file.write((const char *) &edge_count, sizeof(edge_count));
+        auto first_parent = (std::streamoff) (40 + 8 * set_size + 8 * (set_size + 1));
+        std::uint64_t par_pos = 0;
+        file.seekg(first_parent);
+        file.read((char *) &par_pos, sizeof(par_pos));
+        par_pos = (par_pos + 1) % set_size;
+        file.seekp(first_parent);
+        file.write((const char *) &par_pos, sizeof(par_pos));
+    }
+    _printline(std::string("   > snapshot with other relationships is rejected: ") +
+               (tasks.load_order(path) ? "no" : "yes"));
+
+    tasks.emplace(std::make_unique<task>(1));
+    _printline(std::string("   > changed set is rejected: ") + (tasks.load_order(path) ? "no" : "yes"));
+    std::remove(path.c_str());
+}
+
+
+
+void test::task_vector_generate() {
+    _printline("Test1d: task_vector - parallel generation and sort");
+    auto set_size = 200000;
+    auto first = task::reserve_ids(set_size);
+    // Parents are tasks at i/2 and i/3, IDs are reserved: tasks don't depend on the order they are created in.
+    // Stride 1 IDs are indexed by a table, stride 1000 ones - by hash maps.
+    for (task_id stride : { 1, 1000 }) {
+        auto make = [first, stride](size_t i) {
+            auto parents = std::vector<task_id>();
+            if (i > 0) parents.push_back(first + i / 2 * stride);
+            if (i > 2) parents.push_back(first + i / 3 * stride);
+            return task_ptr(new task(first + i * stride, (int) (i % 7), parents));
+        };
+        auto timer = std::chrono::steady_clock::now();
+        auto serial = task_vector();
+        serial.generate(set_size, make);
+        serial.sort(sort_algorithm::critical_path);
+        auto serial_time = _elapsed(timer);
+        timer = std::chrono::steady_clock::now();
+        auto parallel = task_vector();
+        parallel.generate(set_size, make, 4);
+        auto is_sorted = parallel.sort(sort_algorithm::critical_path, 4);
+        auto parallel_time = _elapsed(timer);
+        auto is_same = is_sorted;
+        for (auto i = 0; is_same && i < set_size; ++i) {
+            is_same = serial[i]->id() == parallel[i]->id();
+        }
+        _printline("   > stride " + std::to_string(stride) + ", same order: " + (is_same ? "yes" : "no") +
+                   ", 1 thread: " + std::to_string(serial_time) + " s, 4 threads: " + std::to_string(parallel_time) + " s");
+    }
+
+    auto duplicates = task_vector();
+    duplicates.generate(2, [first](size_t) { return task_ptr(new task(first, 1, {})); });
+    _printline(std::string("   > repeated IDs are rejected: ") + (duplicates.sort() ? "no" : "yes"));
+}
+
+
+
+void test::task_vector_cycle() {
+    _printline("Test1e: task_vector - cycles are reported by sort");
+    // Tasks 1, 2, 3 form a cycle: 2 is a parent of 1, 3 - of 2, 1 - of 3. Task 4 depends on the cycle.
+    auto first = task::reserve_ids(5);
+    auto make = [first](task_vector & Out) {
+        Out.emplace(std::make_unique<task>(first, 1, std::vector<task_id>()));
+        Out.emplace(std::make_unique<task>(first + 1, 2, std::vector<task_id>{ first + 2 }));
+        Out.emplace(std::make_unique<task>(first + 2, 3, std::vector<task_id>{ first + 3 }));
+        Out.emplace(std::make_unique<task>(first + 3, 4, std::vector<task_id>{ first + 1, first }));
+        Out.emplace(std::make_unique<task>(first + 4, 5, std::vector<task_id>{ first + 3 }));
+    };
+    for (auto algorithm : { sort_algorithm::linear, sort_algorithm::chained, sort_algorithm::critical_path }) {
+        auto tasks = task_vector();
+        make(tasks);
+        auto is_sorted = tasks.sort(algorithm, algorithm == sort_algorithm::chained ? 1 : 4);
+        // Any rotation of 3 -> 2 -> 1.
+        auto cycle = tasks.cycle();
+        auto expected = std::vector<task_id>{ first + 3, first + 2, first + 1 };
+        auto is_found = cycle.size() == expected.size();
+        if (is_found) {
+            std::rotate(cycle.begin(), std::find(cycle.begin(), cycle.end(), first + 3), cycle.end());
+            is_found = cycle == expected;
+        }
+        _printline(std::string("   > cycle is found: ") + (!is_sorted && is_found ? "yes" : "no") + " - " +
+                   tasks.sort_error());
+    }
+
+    auto tasks = task_vector();
+    make(tasks);
+    auto manager = task_manager(std::move(tasks), 4);
+    try {
+        manager.run();
+        _printline("   > task_manager has thrown: no");
+    }
+    catch (const std::runtime_error & error) {
+        _printline(std::string("   > task_manager has thrown: yes - ") + error.what());
+    }
+
+    auto missing = task_vector();
+    missing.emplace(std::make_unique<task>(first, 1, std::vector<task_id>{ first + 10 }));
+    missing.sort();
+    _printline("   > missing parent: " + missing.sort_error());
+}
+
+
+
 void test::task_manager_wait() {
     _printline("Test2: task_manager - wait");
     auto tasks = task_vector();
@@ -72,41 +352,435 @@ void test::task_manager_wait() {
     _printline("   > after sort ");
     cout_tasks(tasks);
     auto manager = task_manager(std::move(tasks), 4);
-    auto timer = std::clock();
+    auto timer = std::chrono::steady_clock::now();
+    manager.run();
+    _printline("   > this should appear right now");
+    manager.wait();
+    auto elapsed = _elapsed(timer);
+    _printline("   > this should appear after task_manager finished");
+    _printline("   > elapsed time: " + std::to_string(elapsed));
+}
+
+
+
+void test::task_manager_work_stealing() {
+    _printline("Test2a: task_manager - work stealing");
+    auto tasks = task_vector();
+    task_generator::test_set_custom(true, tasks);
+    auto manager = task_manager(std::move(tasks), 4, schedule_mode::work_stealing);
+    auto timer = std::chrono::steady_clock::now();
     manager.run();
     _printline("   > this should appear right now");
     manager.wait();
-    auto elapsed = (std::clock() - timer) / (double) CLOCKS_PER_SEC;
+    auto elapsed = _elapsed(timer);
     _printline("   > this should appear after task_manager finished");
     _printline("   > elapsed time: " + std::to_string(elapsed));
 }
 
 
 
-void test::sort_performance(std::string && outputfile) {
+void test::task_manager_submit() {
+    _printline("Test2b: task_manager - submit tasks while running");
+    for (auto mode : { schedule_mode::shared_queue, schedule_mode::work_stealing }) {
+        auto tasks = task_vector();
+        task_manager * manager_ptr = nullptr;
+
+        // A "parser" task that discovers 4 files and submits a task per file and a task that merges them.
+        auto parser = std::make_unique<task>(10);
+        auto parser_id = parser->id();
+        parser->bind([&manager_ptr, parser_id]() {
+            task_generator::job(true, parser_id, 10, {});
+            auto merge_parents = std::vector<task_id>();
+            for (auto i = 0; i < 4; ++i) {
+                auto file = std::make_unique<task>(50, parser_id);
+                file->bind(task_generator::job, true, file->id(), file->weight(), file->parents());
+                merge_parents.push_back(file->id());
+                manager_ptr->submit(std::move(file));
+            }
+            auto merge = std::make_unique<task>(20, merge_parents);
+            merge->bind(task_generator::job, true, merge->id(), merge->weight(), merge->parents());
+            manager_ptr->submit(std::move(merge));
+        });
+        tasks.emplace(std::move(parser));
+
+        auto manager = task_manager(std::move(tasks), 2, mode);
+        manager_ptr = &manager;
+        manager.run();
+        manager.wait();
+        _printline("   > this should appear after the merge task finished");
+    }
+}
+
+
+
+void test::thread_pool_graphs() {
+    _printline("Test2c: thread_pool - several graphs at the same time");
+    auto pool = thread_pool(4);
+    auto tasks = task_vector();
+    task_generator::test_set_custom(false, tasks);
+    auto custom = pool.run(std::move(tasks));
+    task_generator::test_set_random_multiparent(20, 1000, false, tasks);
+    auto random = pool.run(std::move(tasks));
+    task_generator::test_set_no_parent(5, 100, true, tasks);
+    auto no_parents = pool.run(std::move(tasks));
+    no_parents.wait();
+    _printline("   > no parents graph is done");
+    random.wait();
+    _printline("   > random multi parent graph is done");
+    custom.wait();
+    _printline("   > custom graph is done");
+}
+
+
+
+void test::typed_graph_pipeline() {
+    _printline("Test2d: typed_graph - parents' results passed to children");
+    auto graph = typed_graph(
+        node(10, []() { return std::vector<int> {1, 2, 3, 4}; }),
+        node<0>(20, [](const std::vector<int> & numbers) {
+            auto sum = 0;
+            for (auto number : numbers) sum += number;
+            return sum;
+        }),
+        node<0>(30, [](const std::vector<int> & numbers) { return std::to_string(numbers.size()) + " numbers"; }),
+        node<1, 2>(5, [](int && sum, std::string && text) { return text + ", sum " + std::to_string(sum); })
+    );
+    graph.run(2);
+    _printline("   > " + graph.result<3>() + " (should be 4 numbers, sum 10)");
+}
+
+
+
+void test::task_vector_dataflow() {
+    _printline("Test2e: task_vector - dataflow tasks");
+    auto tasks = task_vector();
+    auto & numbers = tasks.emplace(10);
+    numbers.bind_dataflow([]() { return std::vector<int> {1, 2, 3, 4}; });
+    auto & sum = tasks.emplace(20, numbers.id());
+    sum.bind_dataflow([](const std::vector<int> & numbers) {
+        auto sum = 0;
+        for (auto number : numbers) sum += number;
+        return sum;
+    });
+    auto & count = tasks.emplace(30, numbers.id());
+    count.bind_dataflow([](std::vector<int> numbers) { return std::to_string(numbers.size()) + " numbers"; });
+    auto & text = tasks.emplace(5, std::vector<task_id> { sum.id(), count.id() });
+    text.bind_dataflow([](int sum, std::string && count) { return count + ", sum " + std::to_string(sum); });
+    auto numbers_id = numbers.id();
+    auto text_id = text.id();
+
+    // A consumer that takes a different number of arguments fails, but still releases its parent's result.
+    auto & letters = tasks.emplace(10);
+    letters.bind_dataflow([]() { return std::string("abc"); });
+    tasks.emplace(1, letters.id()).bind_dataflow([](std::string, int) {});
+    auto letters_id = letters.id();
+
+    auto manager = task_manager(std::move(tasks), 2, schedule_mode::work_stealing);
+    manager.run();
+    auto report = manager.wait();
+    _printline("   > " + *manager.result<std::string>(text_id) + " (should be 4 numbers, sum 10)");
+    _printline(std::string("   > numbers are released: ") + (manager.result<std::vector<int>>(numbers_id) ? "no" : "yes"));
+    _printline(std::string("   > wrong number of arguments fails: ") + (report.failures.size() == 1 ? "yes" : "no") +
+               ", letters are released: " + (manager.result<std::string>(letters_id) ? "no" : "yes"));
+}
+
+
+
+void test::task_manager_trace() {
+    _printline("Test2f: task_manager - tracing");
+    for (auto mode : { schedule_mode::shared_queue, schedule_mode::work_stealing }) {
+        auto tasks = task_vector();
+        task_generator::test_set_random_multiparent(200, 200, false, tasks);
+        auto parents = std::unordered_map<task_id, std::vector<task_id>>();
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            parents[tasks[i]->id()] = tasks[i]->parents();
+        }
+        auto manager = task_manager(std::move(tasks), 4, mode);
+        manager.trace().enable();
+        manager.run();
+        manager.wait();
+
+        // Timestamps are ordered and each task starts after its parents have finished.
+        auto records = manager.trace().records();
+        auto end = std::unordered_map<task_id, std::uint64_t>();
+        for (auto & rec : records) {
+            end[rec.id] = rec.end;
+        }
+        auto is_ordered = records.size() == parents.size();
+        for (auto & rec : records) {
+            is_ordered = is_ordered && rec.ready <= rec.dispatch && rec.dispatch <= rec.start && rec.start <= rec.end;
+            for (auto par_id : parents[rec.id]) {
+                is_ordered = is_ordered && end[par_id] <= rec.ready;
+            }
+        }
+        auto path = std::string("task_manager_trace.json");
+        auto is_written = manager.trace().write_chrome_json(path);
+        std::remove(path.c_str());
+        _printline(std::string("   > ") + (mode == schedule_mode::shared_queue ? "shared queue" : "work stealing") +
+                   ": " + std::to_string(records.size()) + " records, ordered: " + (is_ordered ? "yes" : "no") +
+                   ", written: " + (is_written ? "yes" : "no"));
+    }
+}
+
+
+
+void test::task_manager_metrics() {
+    _printline("Test2g: task_manager - live metrics");
+    for (auto mode : { schedule_mode::shared_queue, schedule_mode::work_stealing }) {
+        // A chain of 20 tasks is the critical path, tasks without parents run beside it.
+        auto tasks = task_vector();
+        task_generator::test_set_worst_singleparent(20, 300, false, tasks);
+        for (auto i = 0; i < 40; ++i) {
+            auto tsk = std::make_unique<task>(1);
+            tsk->bind(task_generator::job, false, tsk->id(), tsk->weight(), tsk->parents());
+            tasks.emplace(std::move(tsk));
+        }
+        auto manager = task_manager(std::move(tasks), 4, mode);
+        manager.metrics().enable();
+        manager.run();
+
+        // Progress never goes back while the graph runs.
+        auto polls = 0;
+        auto is_monotonic = true;
+        auto last = manager.poll_metrics();
+        while (last.left > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            auto current = manager.poll_metrics();
+            is_monotonic = is_monotonic && current.done >= last.done &&
+                           current.critical_path_done >= last.critical_path_done;
+            last = current;
+            ++polls;
+        }
+        manager.wait();
+
+        auto done = manager.poll_metrics();
+        auto busy = 0.0;
+        for (auto & worker : done.workers) {
+            busy += worker.busy;
+        }
+        std::stringstream ss;
+        ss << "   > " << (mode == schedule_mode::shared_queue ? "shared queue" : "work stealing") << ": "
+           << polls << " polls, monotonic: " << (is_monotonic ? "yes" : "no") << ", done: " << done.done
+           << ", ready: " << done.ready << ", critical path done: " << done.critical_path_done
+           << ", busy: " << busy << " s, " << done.throughput << " tasks/s";
+        _printline(ss.str());
+    }
+}
+
+
+
+void test::task_manager_report() {
+    _printline("Test2h: task_manager - efficiency report");
+    // A chain can't be sped up, tasks without parents are bound by the thread count.
+    std::string names[] = { "chain", "no parents" };
+    generator_func sets[] = { &task_generator::test_set_worst_singleparent, &task_generator::test_set_no_parent_equal };
+    for (auto s = 0; s < 2; ++s) {
+        auto tasks = task_vector();
+        sets[s](10, 110, false, tasks);
+        auto manager = task_manager(std::move(tasks), 4, schedule_mode::work_stealing);
+        manager.metrics().enable();
+        manager.run();
+        manager.wait();
+
+        // The run can't be shorter than the span, and the span can't be longer than the work.
+        auto report = manager.report();
+        auto is_bounded = report.span <= report.elapsed && report.span <= report.work &&
+                          report.speedup_bound <= 4 && report.task_count == 10;
+        std::stringstream ss;
+        ss << "   > " << names[s] << ": work " << report.work << " s, span " << report.span << " s, elapsed "
+           << report.elapsed << " s, speedup " << report.speedup << " of " << report.speedup_bound
+           << ", lock wait " << report.lock_wait * 1e6 << " us, overhead " << report.overhead_per_task * 1e6
+           << " us/task, bounded: " << (is_bounded ? "yes" : "no");
+        _printline(ss.str());
+    }
+}
+
+
+
+void test::task_manager_cancel() {
+    _printline("Test2i: task_manager - cancellation");
+    for (auto mode : { schedule_mode::shared_queue, schedule_mode::work_stealing }) {
+        // Two chains of 10 tasks: the 3rd task of the first chain cancels its own subtree.
+        auto tasks = task_vector();
+        task_manager * manager_ptr = nullptr;
+        std::atomic_int executed(0);
+        std::atomic_bool is_token_cancelled(false);
+        auto ids = std::vector<task_id>();
+        for (auto chain = 0; chain < 2; ++chain) {
+            for (auto i = 0; i < 10; ++i) {
+                auto & tsk = i == 0 ? tasks.emplace(1) : tasks.emplace(1, ids.back());
+                auto id = tsk.id();
+                auto is_failing = chain == 0 && i == 2;
+                tsk.bind_detached([&manager_ptr, &executed, &is_token_cancelled, id, is_failing]() {
+                    if (is_failing) {
+                        manager_ptr->cancel(id);
+                        is_token_cancelled = task_manager::current_token().is_cancelled();
+                    }
+                    ++executed;
+                });
+                ids.push_back(id);
+            }
+        }
+        // A skipped dataflow consumer still releases the result of its other parent.
+        auto & letters = tasks.emplace(1);
+        letters.bind_dataflow([]() { return std::string("abc"); });
+        auto & consumer = tasks.emplace(1, std::vector<task_id>{ letters.id(), ids[3] });
+        consumer.bind_dataflow([](std::string) {});
+        auto letters_id = letters.id();
+        auto subtree = std::vector<task_id>(ids.begin() + 3, ids.begin() + 10);
+        subtree.push_back(consumer.id());
+
+        auto manager = task_manager(std::move(tasks), 2, mode);
+        manager_ptr = &manager;
+        manager.run();
+        manager.wait();
+        auto skipped = manager.skipped();
+        std::sort(skipped.begin(), skipped.end());
+        auto is_subtree = skipped == subtree;
+        auto is_released = manager.result<std::string>(letters_id) == nullptr;
+
+        // A chain of spinning tasks that poll their tokens is cancelled as a whole.
+        auto chain = task_vector();
+        for (auto i = 0; i < 100; ++i) {
+            auto & tsk = i == 0 ? chain.emplace(1) : chain.emplace(1, ids.back());
+            tsk.bind_detached([]() {
+                auto start = std::chrono::steady_clock::now();
+                while (!task_manager::current_token().is_cancelled() &&
+                       std::chrono::steady_clock::now() - start < std::chrono::milliseconds(10)) {}
+            });
+            ids.push_back(tsk.id());
+        }
+        auto graph = task_manager(std::move(chain), 2, mode);
+        auto timer = std::chrono::steady_clock::now();
+        graph.run();
+        std::this_thread::sleep_for(std::chrono::milliseconds(35));
+        graph.cancel();
+        graph.wait();
+        auto time = std::chrono::duration<double>(std::chrono::steady_clock::now() - timer).count();
+        auto graph_skipped = graph.skipped().size();
+
+        std::stringstream ss;
+        ss << "   > " << (mode == schedule_mode::shared_queue ? "shared queue" : "work stealing") << ": executed "
+           << executed << ", skipped the subtree: " << (is_subtree ? "yes" : "no") << ", token: "
+           << (is_token_cancelled ? "cancelled" : "not cancelled") << ", results released: "
+           << (is_released ? "yes" : "no") << ", cancelled graph: " << graph_skipped
+           << " of 100 skipped in " << (int) (time * 1000) << " ms";
+        _printline(ss.str());
+    }
+}
+
+
+
+void test::task_manager_failures() {
+    _printline("Test2j: task_manager - failure policies");
+    for (auto mode : { schedule_mode::shared_queue, schedule_mode::work_stealing }) {
+        // Skip dependents: a chain after the failed task is skipped, an independent task is executed.
+        auto tasks = task_vector();
+        auto failing = std::make_unique<task>(10);
+        auto failing_id = failing->id();
+        auto failed_future = failing->bind([]() -> int { throw std::runtime_error("boom"); });
+        tasks.emplace(std::move(failing));
+        auto & child = tasks.emplace(1, failing_id);
+        auto & grandchild = tasks.emplace(1, child.id());
+        auto dependents = std::vector<task_id>{ child.id(), grandchild.id() };
+        auto independent = std::make_unique<task>(1);
+        auto independent_future = independent->bind([]() { return 7; });
+        tasks.emplace(std::move(independent));
+        auto manager = task_manager(std::move(tasks), 2, mode);
+        manager.run();
+        auto report = manager.wait();
+        std::sort(report.skipped.begin(), report.skipped.end());
+        auto is_skipped = report.failures.size() == 1 && report.failures[0].id == failing_id &&
+                          report.failures[0].what == "boom" && report.skipped == dependents &&
+                          independent_future.get() == 7;
+        auto is_future_failed = false;
+        try {
+            failed_future.get();
+        }
+        catch (const std::runtime_error &) {
+            is_future_failed = true;
+        }
+
+        // Retry: a task that fails twice succeeds on the third attempt, its future gets the result.
+        auto retried = task_vector();
+        auto attempts = std::make_shared<int>(0);
+        auto flaky = std::make_unique<task>(1);
+        auto flaky_future = flaky->bind([attempts]() {
+            if (++*attempts < 3) throw std::runtime_error("not yet");
+            return 42;
+        });
+        retried.emplace(std::move(flaky));
+        auto retry_manager = task_manager(std::move(retried), 2, mode);
+        retry_manager.set_failure_policy(failure_policy::skip_dependents, 2);
+        retry_manager.run();
+        auto is_retried = retry_manager.wait().empty() && flaky_future.get() == 42;
+
+        // Abort: the heaviest task goes first and fails, the rest of the graph is skipped.
+        auto aborted = task_vector();
+        aborted.emplace(100).bind_detached([]() { throw 1; });
+        for (auto i = 0; i < 20; ++i) {
+            aborted.emplace(1).bind_detached([]() {});
+        }
+        auto abort_manager = task_manager(std::move(aborted), 1, mode);
+        abort_manager.set_failure_policy(failure_policy::abort);
+        abort_manager.run();
+        auto abort_report = abort_manager.wait();
+        auto is_aborted = abort_report.is_cancelled && abort_report.skipped.size() == 20 &&
+                          abort_report.failures.size() == 1 && abort_report.failures[0].what == "unknown exception";
+
+        _printline(std::string("   > ") + (mode == schedule_mode::shared_queue ? "shared queue" : "work stealing") +
+                   ": dependents skipped: " + (is_skipped ? "yes" : "no") + ", future failed: " +
+                   (is_future_failed ? "yes" : "no") + ", retried: " + (is_retried ? "yes" : "no") +
+                   ", aborted: " + (is_aborted ? "yes" : "no"));
+        _printline("   > " + report.message());
+    }
+
+    // A thread_pool skips dependents of failed tasks.
+    auto pool = thread_pool(2);
+    auto tasks = task_vector();
+    auto & failing = tasks.emplace(1);
+    failing.bind_detached([]() { throw std::logic_error("detached"); });
+    tasks.emplace(1, failing.id()).bind_detached([]() {});
+    auto report = pool.run(std::move(tasks)).wait();
+    _printline("   > thread_pool: " + report.message());
+}
+
+
+
+// Each set is sorted by 1, 2, 4, ... max_thread_count threads.
+void test::sort_performance(std::string && outputfile, int max_thread_count) {
     _printline("Test3: task_sort - performance");
     std::ofstream fout;
     fout.open(outputfile);
-    fout << "set_size,worst_case_single,random_single,no_parents" << std::endl;
+    fout << "set_size,thread_count,worst_case_single,random_single,no_parents,"
+         << "worst_case_single_linear,random_single_linear,no_parents_linear,single_root_linear" << std::endl;
 
     std::stringstream ss;
-    std::vector<int> mult = {1, 2, 3, 4, 6, 8, 10, 14, 16, 20, 40, 60, 80, 100};
+    std::vector<int> mult = {1, 2, 3, 4, 6, 8, 10, 14, 16, 20, 40, 60, 80, 100, 200, 400, 600, 800, 1000};
     for (auto i : mult) {
         auto set_size = i*100000;
-        auto worst_single = _tasks_sort(&task_generator::test_set_worst_singleparent, set_size);
-        auto random_single = _tasks_sort(&task_generator::test_set_random_singleparent, set_size);
-        auto no_parents = _tasks_sort(&task_generator::test_set_no_parent, set_size);
-        ss.str("");
-        ss << set_size << "," << worst_single << "," << random_single << "," << no_parents;
-        fout << ss.str() << std::endl;
-        _printline("   > sorting " + ss.str());
+        for (auto t = 1; t <= max_thread_count; t *= 2) {
+            auto worst_single = _tasks_sort(&task_generator::test_set_worst_singleparent, set_size, sort_algorithm::chained, t);
+            auto random_single = _tasks_sort(&task_generator::test_set_random_singleparent, set_size, sort_algorithm::chained, t);
+            auto no_parents = _tasks_sort(&task_generator::test_set_no_parent, set_size, sort_algorithm::chained, t);
+            auto worst_single_linear = _tasks_sort(&task_generator::test_set_worst_singleparent, set_size, sort_algorithm::linear, t);
+            auto random_single_linear = _tasks_sort(&task_generator::test_set_random_singleparent, set_size, sort_algorithm::linear, t);
+            auto no_parents_linear = _tasks_sort(&task_generator::test_set_no_parent, set_size, sort_algorithm::linear, t);
+            auto single_root_linear = _tasks_sort(&task_generator::test_set_single_root, set_size, sort_algorithm::linear, t);
+            ss.str("");
+            ss << set_size << "," << t << "," << worst_single << "," << random_single << "," << no_parents
+               << "," << worst_single_linear << "," << random_single_linear << "," << no_parents_linear
+               << "," << single_root_linear;
+            fout << ss.str() << std::endl;
+            _printline("   > sorting " + ss.str());
+        }
     }
     fout.close();
 }
 
 
 
-void test::performance_vs_thread(int max_count, std::string && outputfile) {
+void test::performance_vs_thread(int max_count, std::string && outputfile, schedule_mode mode) {
     _printline("Test4: task_manager - performance vs thread count");
     std::ofstream fout;
     fout.open(outputfile);
@@ -120,16 +794,16 @@ void test::performance_vs_thread(int max_count, std::string && outputfile) {
         times.clear();
         ss.str("");
 
-        times.push_back( _measure_time(&task_generator::test_set_worst_singleparent, i, 10, 5005) );
-        times.push_back( _measure_time(&task_generator::test_set_worst_singleparent, i, 100, 5050) );
-        times.push_back( _measure_time(&task_generator::test_set_worst_multiparent, i, 10, 5005) );
-        times.push_back( _measure_time(&task_generator::test_set_worst_multiparent, i, 100, 5050) );
-        times.push_back( _measure_time(&task_generator::test_set_random_singleparent, i, 10, 5005) );
-        times.push_back( _measure_time(&task_generator::test_set_random_singleparent, i, 100, 5050) );
-        times.push_back( _measure_time(&task_generator::test_set_random_multiparent, i, 10, 5005) );
-        times.push_back( _measure_time(&task_generator::test_set_random_multiparent, i, 100, 5050) );
-        times.push_back( _measure_time(&task_generator::test_set_no_parent, i, 10, 5005) );
-        times.push_back( _measure_time(&task_generator::test_set_no_parent, i, 100, 5050) );
+        times.push_back( _measure_time(&task_generator::test_set_worst_singleparent, i, 10, 5005, mode) );
+        times.push_back( _measure_time(&task_generator::test_set_worst_singleparent, i, 100, 5050, mode) );
+        times.push_back( _measure_time(&task_generator::test_set_worst_multiparent, i, 10, 5005, mode) );
+        times.push_back( _measure_time(&task_generator::test_set_worst_multiparent, i, 100, 5050, mode) );
+        times.push_back( _measure_time(&task_generator::test_set_random_singleparent, i, 10, 5005, mode) );
+        times.push_back( _measure_time(&task_generator::test_set_random_singleparent, i, 100, 5050, mode) );
+        times.push_back( _measure_time(&task_generator::test_set_random_multiparent, i, 10, 5005, mode) );
+        times.push_back( _measure_time(&task_generator::test_set_random_multiparent, i, 100, 5050, mode) );
+        times.push_back( _measure_time(&task_generator::test_set_no_parent, i, 10, 5005, mode) );
+        times.push_back( _measure_time(&task_generator::test_set_no_parent, i, 100, 5050, mode) );
 
         ss << i;
         for (auto time : times) {
@@ -143,6 +817,103 @@ void test::performance_vs_thread(int max_count, std::string && outputfile) {
 
 
 
+void test::dispatch_performance(std::string && outputfile) {
+    _printline("Test4a: task_vector - dispatch performance vs set size");
+    std::ofstream fout;
+    fout.open(outputfile);
+    fout << "set_size,worst_case_single,random_single,no_parents" << std::endl;
+
+    std::stringstream ss;
+    std::vector<int> mult = {1, 2, 3, 4, 6, 8, 10, 14, 16, 20, 40, 60, 80, 100};
+    for (auto i : mult) {
+        auto set_size = i*10000;
+        auto worst_single = _tasks_dispatch(&task_generator::test_set_worst_singleparent, set_size);
+        auto random_single = _tasks_dispatch(&task_generator::test_set_random_singleparent, set_size);
+        auto no_parents = _tasks_dispatch(&task_generator::test_set_no_parent, set_size);
+        ss.str("");
+        ss << set_size << "," << worst_single << "," << random_single << "," << no_parents;
+        fout << ss.str() << std::endl;
+        _printline("   > dispatching " + ss.str());
+    }
+    fout.close();
+}
+
+
+
+void test::performance_vs_priority(int max_count, std::string && outputfile) {
+    _printline("Test4b: task_manager - weight vs critical path priority (100 tasks)");
+    std::ofstream fout;
+    fout.open(outputfile);
+    fout << "thread_count,worst_single_weight,worst_single_critical_path,worst_multi_weight,worst_multi_critical_path,"
+         << "random_single_weight,random_single_critical_path,random_multi_weight,random_multi_critical_path,"
+         << "no_parents_weight,no_parents_critical_path,no_parents_equal_weight,no_parents_equal_critical_path" << std::endl;
+
+    std::vector<generator_func> sets = {
+        &task_generator::test_set_worst_singleparent,
+        &task_generator::test_set_worst_multiparent,
+        &task_generator::test_set_random_singleparent,
+        &task_generator::test_set_random_multiparent,
+        &task_generator::test_set_no_parent,
+        &task_generator::test_set_no_parent_equal
+    };
+    std::stringstream ss;
+    for (auto i = 1; i < max_count; ++i) {
+        ss.str("");
+        ss << i;
+        for (auto & set : sets) {
+            ss << "," << _measure_time(set, i, 100, 5050, schedule_mode::shared_queue, sort_algorithm::linear);
+            ss << "," << _measure_time(set, i, 100, 5050, schedule_mode::shared_queue, sort_algorithm::critical_path);
+        }
+        _printline("   > task_manager " + ss.str());
+        fout << ss.str() << std::endl;
+    }
+    fout.close();
+}
+
+
+
+void test::performance_vs_graph_count(std::string && outputfile) {
+    _printline("Test4c: task_manager vs thread_pool - many small graphs (10 tasks, 4 threads)");
+    std::ofstream fout;
+    fout.open(outputfile);
+    fout << "graph_count,task_manager,thread_pool" << std::endl;
+
+    std::stringstream ss;
+    std::vector<int> counts = {10, 100, 1000, 10000};
+    for (auto count : counts) {
+        auto tasks = task_vector();
+
+        // A new task_manager (and its threads) per graph.
+        auto timer = std::chrono::steady_clock::now();
+        for (auto i = 0; i < count; ++i) {
+            task_generator::test_set_no_parent(10, 0, false, tasks);
+            auto manager = task_manager(std::move(tasks), 4);
+            manager.run();
+            manager.wait();
+        }
+        auto manager_time = _elapsed(timer);
+
+        // One pool for all graphs.
+        timer = std::chrono::steady_clock::now();
+        {
+            auto pool = thread_pool(4);
+            for (auto i = 0; i < count; ++i) {
+                task_generator::test_set_no_parent(10, 0, false, tasks);
+                pool.run(std::move(tasks)).wait();
+            }
+        }
+        auto pool_time = _elapsed(timer);
+
+        ss.str("");
+        ss << count << "," << manager_time << "," << pool_time;
+        _printline("   > graphs " + ss.str());
+        fout << ss.str() << std::endl;
+    }
+    fout.close();
+}
+
+
+
 void test::performance_vs_set_size_fixed_total_runtime(std::string && outputfile) {
     _printline("Test5: task_manager - performance vs set size (100 s total runtime)");
     std::ofstream fout;
@@ -259,24 +1030,53 @@ void test::_printline(std::string && text) {
 
 
 
-double test::_tasks_sort(const generator_func & func, int set_size) {
+// Wall-clock time in seconds: std::clock() sums CPU time of all threads.
+double test::_elapsed(std::chrono::steady_clock::time_point timer) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - timer).count();
+}
+
+
+
+double test::_tasks_sort(const generator_func & func, int set_size, sort_algorithm algorithm, int thread_count) {
+    auto tasks = task_vector();
+    func(set_size, 1000, false, tasks);
+    auto timer = std::chrono::steady_clock::now();
+    tasks.sort(algorithm, thread_count);
+    return _elapsed(timer);
+}
+
+
+
+// Pops and marks done all tasks in one thread without executing them: pure dispatch cost.
+double test::_tasks_dispatch(const generator_func & func, int set_size) {
     auto tasks = task_vector();
     func(set_size, 1000, false, tasks);
-    auto timer = std::clock();
     tasks.sort();
-    return (std::clock() - timer) / (double) CLOCKS_PER_SEC;
+    auto timer = std::chrono::steady_clock::now();
+    task_ptr tsk;
+    size_t pos = 0;
+    auto has_next = true;
+    while (has_next) {
+        tsk.reset();
+        has_next = tasks.pop_next(tsk, pos);
+        if (tsk != nullptr) {
+            tasks.set_done(pos);
+        }
+    }
+    return _elapsed(timer);
 }
 
 
 
-double test::_measure_time(const generator_func & func, int thread_count, int set_size, long total_millisec) {
+double test::_measure_time(const generator_func & func, int thread_count, int set_size, long total_millisec,
+                          schedule_mode mode, sort_algorithm algorithm) {
     auto tasks = task_vector();
     func(set_size, total_millisec, false, tasks);
-    auto manager = task_manager(std::move(tasks), thread_count);
-    auto timer = std::clock();
+    auto manager = task_manager(std::move(tasks), thread_count, mode, algorithm);
+    auto timer = std::chrono::steady_clock::now();
     manager.run();
     manager.wait();
-    return (std::clock() - timer) / (double) CLOCKS_PER_SEC;
+    return _elapsed(timer);
 }
 
 
@@ -284,7 +1084,7 @@ double test::_measure_time(const generator_func & func, int thread_count, int se
 // This method is only use to measure time of launching tasks without task_manager.
 double test::_measure_time(int set_size, long total_millisec) {
     auto job = total_millisec / set_size;
-    clock_t timer = std::clock();
+    auto timer = std::chrono::steady_clock::now();
     volatile int i = 0;
     for (i = 0; i < set_size; ++i) {
         bool sleep = true;
@@ -298,7 +1098,7 @@ double test::_measure_time(int set_size, long total_millisec) {
                 sleep = false;
         }
     }
-    return (std::clock() - timer) / (double) CLOCKS_PER_SEC;
+    return _elapsed(timer);
 }
 
 }
\ No newline at end of file
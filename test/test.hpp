@@ -1,6 +1,7 @@
 #pragma once
 #include "../include/task_manager.hpp"
 #include <functional>
+#include <chrono>
 
 namespace qp {
 
@@ -10,9 +11,27 @@ class test {
 public:
     test() = delete;
     static void task_sort_order();
+    static void task_vector_arena();
+    static void task_vector_mapped();
+    static void task_vector_snapshot();
+    static void task_vector_generate();
+    static void task_vector_cycle();
     static void task_manager_wait();
-    static void sort_performance(std::string && outputfile);
-    static void performance_vs_thread(int max_count, std::string && outputfile);
+    static void task_manager_work_stealing();
+    static void task_manager_submit();
+    static void thread_pool_graphs();
+    static void typed_graph_pipeline();
+    static void task_vector_dataflow();
+    static void task_manager_trace();
+    static void task_manager_metrics();
+    static void task_manager_report();
+    static void task_manager_cancel();
+    static void task_manager_failures();
+    static void sort_performance(std::string && outputfile, int max_thread_count = 1);
+    static void performance_vs_thread(int max_count, std::string && outputfile, schedule_mode mode = schedule_mode::shared_queue);
+    static void dispatch_performance(std::string && outputfile);
+    static void performance_vs_priority(int max_count, std::string && outputfile);
+    static void performance_vs_graph_count(std::string && outputfile);
     static void performance_vs_set_size_fixed_total_runtime(std::string && outputfile);
     static void performance_vs_set_size_fixed_task_duration(std::string && outputfile);
     static void performance_vs_task_duration(std::string && outputfile);
@@ -20,8 +39,12 @@ public:
 
 private:
     static void _printline(std::string && text);
-    static double _tasks_sort(const generator_func & func, int set_size);
-    static double _measure_time(const generator_func & func, int thread_count, int set_size, long total_millisec);
+    static double _elapsed(std::chrono::steady_clock::time_point timer);
+    static double _tasks_sort(const generator_func & func, int set_size, sort_algorithm algorithm = sort_algorithm::linear,
+                              int thread_count = 1);
+    static double _tasks_dispatch(const generator_func & func, int set_size);
+    static double _measure_time(const generator_func & func, int thread_count, int set_size, long total_millisec,
+                                schedule_mode mode = schedule_mode::shared_queue, sort_algorithm algorithm = sort_algorithm::linear);
     static double _measure_time(int set_size, long total_millisec);
 
 };